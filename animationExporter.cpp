@@ -0,0 +1,234 @@
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+#include "animationExporter.h"
+
+CameraPath::CameraPath()
+{
+}
+
+bool CameraPath::load(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file)
+		return false;
+
+	m_keyframes.clear();
+
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		std::istringstream stream(line);
+		PathBounds bounds;
+
+		if (!(stream >> bounds.xMin >> bounds.xMax >> bounds.yMin >> bounds.yMax) || !(bounds.xMax > bounds.xMin) || !(bounds.yMax > bounds.yMin))
+		{
+			m_keyframes.clear();
+			return false;
+		}
+
+		m_keyframes.push_back(bounds);
+	}
+
+	return !m_keyframes.empty();
+}
+
+void CameraPath::addKeyframe(const PathBounds& bounds)
+{
+	m_keyframes.push_back(bounds);
+}
+
+unsigned int CameraPath::getKeyframeCount() const
+{
+	return (unsigned int)m_keyframes.size();
+}
+
+PathBounds CameraPath::at(double t) const
+{
+	if (m_keyframes.empty())
+		return { 0., 1., 0., 1. };
+
+	if (t <= 0.)
+		return m_keyframes.front();
+
+	if (t >= (double)(m_keyframes.size() - 1))
+		return m_keyframes.back();
+
+	std::size_t index((std::size_t)t);
+	double f(t - (double)index);
+
+	const PathBounds& a(m_keyframes[index]);
+	const PathBounds& b(m_keyframes[index + 1]);
+
+	double widthA(a.xMax - a.xMin), widthB(b.xMax - b.xMin);
+	double heightA(a.yMax - a.yMin), heightB(b.yMax - b.yMin);
+
+	double width(widthA == widthB ? widthA : widthA * std::pow(widthB / widthA, f));
+	double height(heightA == heightB ? heightA : heightA * std::pow(heightB / heightA, f));
+
+	// Views sharing a fixed point are scaled around it: the center moves in proportion to the size change
+	double u(widthA == widthB ? f : (widthA - width) / (widthA - widthB));
+	double centerX((a.xMin + a.xMax) * 0.5 + u * ((b.xMin + b.xMax) * 0.5 - (a.xMin + a.xMax) * 0.5));
+	double centerY((a.yMin + a.yMax) * 0.5 + u * ((b.yMin + b.yMax) * 0.5 - (a.yMin + a.yMax) * 0.5));
+
+	return { centerX - width * 0.5, centerX + width * 0.5, centerY - height * 0.5, centerY + height * 0.5 };
+}
+
+AnimationExporter::AnimationExporter()
+{
+	m_width = 0;
+	m_height = 0;
+}
+
+bool AnimationExporter::run(const std::string& path, const CameraPath& camera, unsigned int width, unsigned int height, unsigned int frameCount, const AreaFunction& renderArea)
+{
+	if (width == 0 || height == 0 || frameCount == 0 || camera.getKeyframeCount() == 0)
+		return false;
+
+	m_width = width;
+	m_height = height;
+
+	bool toStdout(path == "-");
+	std::FILE* output(toStdout ? stdout : std::fopen(path.c_str(), "wb"));
+
+	if (output == nullptr)
+		return false;
+
+#if defined(_WIN32)
+	if (toStdout)
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	// The frames own stdout, any message goes to stderr meanwhile
+	std::streambuf* coutBuffer(std::cout.rdbuf());
+
+	if (toStdout)
+		std::cout.rdbuf(std::cerr.rdbuf());
+
+	std::size_t frameSize((std::size_t)width * height);
+	std::vector<sf::Color> frames[2];
+	std::future<bool> written;
+
+	FrameGrid previous = { 0., 0., 0., 0., 0, 0 };
+	unsigned long long reusedPixels(0);
+	bool success(true);
+	sf::Clock clock;
+
+	for (unsigned int i(0); i < frameCount && success; i++)
+	{
+		double t(frameCount > 1 ? (double)i * (camera.getKeyframeCount() - 1) / (frameCount - 1) : 0.);
+		PathBounds bounds(camera.at(t));
+		FrameGrid grid = { bounds.xMin, bounds.yMin, (bounds.xMax - bounds.xMin) / width, (bounds.yMax - bounds.yMin) / height, 0, 0 };
+
+		// The other buffer holds the previous frame, being written
+		std::vector<sf::Color>& frame(frames[i % 2]);
+		const std::vector<sf::Color>& last(frames[(i + 1) % 2]);
+		int offsetX(0), offsetY(0);
+
+		frame.resize(frameSize);
+
+		if (i > 0 && reuse(previous, grid, offsetX, offsetY))
+		{
+			// Pixel (x, y) of this frame is pixel (x + offsetX, y + offsetY) of the previous one
+			unsigned int copyWidth(width - (unsigned int)std::abs(offsetX));
+			unsigned int copyHeight(height - (unsigned int)std::abs(offsetY));
+			unsigned int fromX((unsigned int)std::max(offsetX, 0)), toX((unsigned int)std::max(-offsetX, 0));
+			unsigned int fromY((unsigned int)std::max(offsetY, 0)), toY((unsigned int)std::max(-offsetY, 0));
+
+			for (unsigned int y(0); y < copyHeight; y++)
+				std::memcpy(&frame[(std::size_t)(toY + y) * width + toX], &last[(std::size_t)(fromY + y) * width + fromX], copyWidth * sizeof(sf::Color));
+
+			// Rows that came into view span the frame, columns only the copied rows
+			if (offsetY != 0)
+			{
+				sf::IntRect rows(0, offsetY > 0 ? (int)copyHeight : 0, (int)width, std::abs(offsetY));
+				renderArea(grid.xMin, grid.yMin, grid.dx, grid.dy, grid.left, grid.top, rows, frame.data() + (std::size_t)rows.top * width, width);
+			}
+
+			if (offsetX != 0)
+			{
+				sf::IntRect columns(offsetX > 0 ? (int)copyWidth : 0, (int)toY, std::abs(offsetX), (int)copyHeight);
+				renderArea(grid.xMin, grid.yMin, grid.dx, grid.dy, grid.left, grid.top, columns, frame.data() + (std::size_t)columns.top * width + (std::size_t)columns.left, width);
+			}
+
+			reusedPixels += (unsigned long long)copyWidth * copyHeight;
+		}
+		else
+		{
+			renderArea(grid.xMin, grid.yMin, grid.dx, grid.dy, grid.left, grid.top, sf::IntRect(0, 0, (int)width, (int)height), frame.data(), width);
+		}
+
+		// The previous frame was written while this one was computed
+		if (written.valid())
+			success = written.get();
+
+		written = std::async(std::launch::async, [output, &frame, frameSize] { return std::fwrite(frame.data(), sizeof(sf::Color), frameSize, output) == frameSize; });
+		previous = grid;
+
+		std::cerr << "\rFrame " << i + 1 << "/" << frameCount << std::flush;
+	}
+
+	if (written.valid())
+		success = written.get() && success;
+
+	success = std::fflush(output) == 0 && success;
+
+	if (!toStdout)
+		success = std::fclose(output) == 0 && success;
+
+	std::cout.rdbuf(coutBuffer);
+
+	std::cerr << std::endl << frameCount << " frames of " << width << "x" << height << " in " << clock.getElapsedTime().asSeconds() << "s, "
+		<< reusedPixels * 100 / ((unsigned long long)frameSize * frameCount) << "% of the pixels reused" << std::endl;
+
+	return success;
+}
+
+// PRIVATE
+bool AnimationExporter::reuse(const FrameGrid& previous, FrameGrid& grid, int& offsetX, int& offsetY) const
+{
+	// Same pixel size, to within the tolerance across the whole frame
+	if (std::fabs(grid.dx - previous.dx) * m_width > ANIMATION_REUSE_TOLERANCE * std::fabs(previous.dx)
+		|| std::fabs(grid.dy - previous.dy) * m_height > ANIMATION_REUSE_TOLERANCE * std::fabs(previous.dy))
+		return false;
+
+	double shiftX((grid.xMin - previous.xMin) / previous.dx);
+	double shiftY((grid.yMin - previous.yMin) / previous.dy);
+	double pixelsX(std::round(shiftX)), pixelsY(std::round(shiftY));
+
+	if (std::fabs(shiftX - pixelsX) > ANIMATION_REUSE_TOLERANCE || std::fabs(shiftY - pixelsY) > ANIMATION_REUSE_TOLERANCE
+		|| std::fabs(pixelsX) >= (double)m_width || std::fabs(pixelsY) >= (double)m_height)
+		return false;
+
+	// Exactly on the previous grid, so the copied pixels are where this frame wants them
+	grid.xMin = previous.xMin + pixelsX * previous.dx;
+	grid.yMin = previous.yMin + pixelsY * previous.dy;
+	grid.dx = previous.dx;
+	grid.dy = previous.dy;
+	grid.left = previous.left + (long long)pixelsX;
+	grid.top = previous.top + (long long)pixelsY;
+
+	offsetX = (int)pixelsX;
+	offsetY = (int)pixelsY;
+
+	return true;
+}
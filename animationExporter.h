@@ -0,0 +1,72 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A frame reuses the previous one when the camera moved by whole pixels, give or take this much (in pixels, across the frame)
+#define ANIMATION_REUSE_TOLERANCE 0.1
+
+/*
+- A camera path is a list of keyframe bounds, one per line of a text file: "xMin xMax yMin yMax", '#' starts a comment
+- Between two keyframes the size changes geometrically, so a zoom keeps a steady pace, and the center moves so that
+  the point both views share stays in place on screen (a pan when the size does not change)
+- The exporter spreads the frames evenly over the path and writes them as raw RGBA, row after row, to a file or to stdout ("-")
+- Frame N + 1 is computed while frame N is written
+- A frame at the same scale as the previous one, moved by whole pixels (a pan or a still), copies the pixels they share
+  and only computes the strips that came into view; a zoom changes every pixel and is computed in full
+*/
+
+// Bounds in double: a path interpolated in float wobbles once zoomed in
+struct PathBounds
+{
+	double xMin;
+	double xMax;
+	double yMin;
+	double yMax;
+};
+
+class CameraPath
+{
+	public:
+		CameraPath();
+
+		bool load(const std::string& path);
+		void addKeyframe(const PathBounds& bounds);
+		unsigned int getKeyframeCount() const;
+
+		// From 0 (first keyframe) to getKeyframeCount() - 1 (last one)
+		PathBounds at(double t) const;
+
+	private:
+		std::vector<PathBounds> m_keyframes;
+};
+
+class AnimationExporter
+{
+	public:
+		// Computes an area of a frame whose pixel (0, 0) is at (xMin, yMin), pixels dx by dy, into pixels, rows stride pixels apart
+		// Pixel (0, 0) is pixel (frameX, frameY) of the grid the frame shares with those it reused pixels from
+		typedef std::function<void(double, double, double, double, long long, long long, const sf::IntRect&, sf::Color*, unsigned int)> AreaFunction;
+
+		AnimationExporter();
+
+		bool run(const std::string& path, const CameraPath& camera, unsigned int width, unsigned int height, unsigned int frameCount, const AreaFunction& renderArea);
+
+	private:
+		struct FrameGrid
+		{
+			double xMin;
+			double yMin;
+			double dx;
+			double dy;
+			long long left;		// Pixel (0, 0) on the grid of the frames since the last one computed in full
+			long long top;
+		};
+
+		bool reuse(const FrameGrid& previous, FrameGrid& grid, int& offsetX, int& offsetY) const;
+
+		unsigned int m_width;
+		unsigned int m_height;
+};
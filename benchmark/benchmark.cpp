@@ -0,0 +1,421 @@
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../mainWindow.h"
+#include "../plot.h"
+
+/*
+- Measures the hot paths of the plotter and prints the results as JSON, to compare two versions
+- Every case is repeated for a minimum time, the median iteration is reported
+- Usage: plotBenchmark [--quick] [--no-upload] [--output results.json]
+*/
+
+#define BENCHMARK_MIN_TIME 1.f
+#define BENCHMARK_QUICK_MIN_TIME 0.2f
+#define BENCHMARK_MIN_ITERATIONS 3
+
+struct Result
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> parameters;
+    unsigned int iterations = 0;
+    double seconds = 0.0;        // Median time of one iteration
+    double itemsPerSecond = 0.0;
+    std::string itemName;
+};
+
+static float minTime(BENCHMARK_MIN_TIME);
+static std::vector<Result> results;
+
+// Runs iteration() until minTime has passed, returns the median duration of one call
+template <class Function>
+static double measure(Function iteration, unsigned int& iterations)
+{
+    std::vector<double> durations;
+    sf::Clock total;
+
+    iteration();        // Warm up: caches, lazy allocations, thread start
+
+    while (durations.size() < BENCHMARK_MIN_ITERATIONS || total.getElapsedTime().asSeconds() < minTime)
+    {
+        sf::Clock clock;
+        iteration();
+        durations.push_back((double)clock.getElapsedTime().asMicroseconds() * 1e-6);
+    }
+
+    std::sort(durations.begin(), durations.end());
+    iterations = (unsigned int)durations.size();
+
+    return durations[durations.size() / 2];
+}
+
+static void addResult(const std::string& name, const std::vector<std::pair<std::string, std::string>>& parameters,
+    unsigned int iterations, double seconds, double items, const std::string& itemName)
+{
+    Result result;
+    result.name = name;
+    result.parameters = parameters;
+    result.iterations = iterations;
+    result.seconds = seconds;
+    result.itemsPerSecond = seconds > 0.0 ? items / seconds : 0.0;
+    result.itemName = itemName;
+
+    results.push_back(result);
+    std::cerr << name << ": " << seconds * 1e3 << " ms, " << result.itemsPerSecond << " " << itemName << "/s" << std::endl;
+}
+
+template <class Kernel>
+static void benchmarkCompute(const std::string& kernelName, unsigned int width, unsigned int height, unsigned int threads, unsigned int adaptiveDepth = 0)
+{
+    SharedData data;
+    Camera camera;
+    camera.bounds = { -2.2f, 0.8f, -1.2f, 1.2f };
+    camera.windowWidth = width;
+    camera.windowHeight = height;
+    data.camera.submit(camera);
+
+    Plot<Kernel> plot(&data, Kernel(), threads);
+    unsigned int iterations;
+
+    AdaptiveSampling adaptive;
+    adaptive.depth = adaptiveDepth;
+    plot.setAdaptiveSampling(adaptive);
+
+    // Full frames only: without invalidate() an unchanged view has nothing left to compute
+    double seconds(measure([&plot]
+    {
+        plot.invalidate();
+        plot.compute();
+    }, iterations));
+
+    addResult("compute", { { "kernel", kernelName }, { "width", std::to_string(width) }, { "height", std::to_string(height) }, { "threads", std::to_string(threads) },
+        { "adaptiveDepth", std::to_string(adaptiveDepth) } }, iterations, seconds, (double)width * height, "pixels");
+}
+
+static void benchmarkMapping()
+{
+    const unsigned int calls(1000000);
+
+    SharedData data;
+    Camera camera;
+    camera.bounds = { -2.2f, 0.8f, -1.2f, 1.2f };
+    data.camera.submit(camera);
+
+    Plot<SolidKernel> plot(&data, SolidKernel(), 1);
+    plot.updatePlotSettings();
+
+    unsigned int iterations;
+    volatile float worldSink(0.f);
+    volatile int screenSink(0);
+
+    double seconds(measure([&]
+    {
+        float sum(0.f);
+        for (unsigned int i(0); i < calls; i++)
+            sum += plot.screenToWorld((int)(i % DEFAULT_WIN_WIDTH), (int)(i % DEFAULT_WIN_HEIGHT)).x;
+
+        worldSink = sum;
+    }, iterations));
+
+    addResult("screenToWorld", {}, iterations, seconds, calls, "calls");
+
+    seconds = measure([&]
+    {
+        int sum(0);
+        for (unsigned int i(0); i < calls; i++)
+            sum += plot.worldToScreen(-2.2f + (float)(i % 1000) * 0.003f, -1.2f + (float)(i % 800) * 0.003f).x;
+
+        screenSink = sum;
+    }, iterations);
+
+    addResult("worldToScreen", {}, iterations, seconds, calls, "calls");
+}
+
+// setPixelColor() is gone, pixels are now stored straight into the frame: this is its replacement
+static void benchmarkPixelStore(unsigned int width, unsigned int height)
+{
+    Frame frame;
+    frame.resize(width, height);
+
+    unsigned int iterations;
+
+    // Tile by tile, in the order the compute side writes them
+    double seconds(measure([&frame, width, height]
+    {
+        for (unsigned int top(0); top < height; top += TILE_SIZE)
+        {
+            for (unsigned int left(0); left < width; left += TILE_SIZE)
+            {
+                for (unsigned int y(top); y < std::min(top + TILE_SIZE, height); y++)
+                {
+                    sf::Color* pixels(frame.pixelAt(left, y));
+
+                    for (unsigned int x(0); x < std::min((unsigned int)TILE_SIZE, width - left); x++)
+                        pixels[x] = sf::Color((sf::Uint8)x, (sf::Uint8)y, 10);
+                }
+            }
+        }
+    }, iterations));
+
+    addResult("pixelStore", { { "width", std::to_string(width) }, { "height", std::to_string(height) } }, iterations, seconds, (double)width * height, "pixels");
+
+    frame.release();
+}
+
+// Tiled frame back to rows, done by the window before every full upload
+static void benchmarkDetile(unsigned int width, unsigned int height)
+{
+    Frame frame;
+    frame.resize(width, height);
+    frame.setPhase(TILE_SIZE / 2, TILE_SIZE / 2);
+    frame.fill(sf::Color(128, 128, 128));
+
+    std::vector<sf::Uint8> rows((std::size_t)width * height * 4);
+    unsigned int iterations;
+
+    double seconds(measure([&frame, &rows, width, height]
+    {
+        frame.copyRegion(sf::IntRect(0, 0, (int)width, (int)height), rows.data());
+    }, iterations));
+
+    addResult("detile", { { "width", std::to_string(width) }, { "height", std::to_string(height) } }, iterations, seconds, (double)width * height, "pixels");
+
+    frame.release();
+}
+
+static void benchmarkGrid()
+{
+    Display::Grid grid;
+    sf::Font font;
+    font.loadFromFile("consola.ttf");
+
+    Bounds bounds = { -1.92f, 1.92f, -1.08f, 1.08f };
+    sf::Vector2u windowSize(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT);
+    unsigned int iterations;
+
+    const unsigned int repeats(100);
+
+    // A single grid takes microseconds, below what the clock can tell apart
+    double seconds(measure([&]
+    {
+        for (unsigned int i(0); i < repeats; i++)
+        {
+            Display::MainWindow::computeGrid(grid, bounds, windowSize);
+            Display::MainWindow::createGridLabels(grid, font);
+        }
+    }, iterations));
+
+    addResult("grid", { { "lines", std::to_string(grid.m_abscissLines.size() + grid.m_ordinateLines.size()) } }, iterations, seconds, repeats, "grids");
+}
+
+static bool contextAvailable()
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+    // SFML aborts when it cannot reach a display, so do not even try
+    return getenv("DISPLAY") != nullptr;
+#else
+    return true;
+#endif
+}
+
+static void benchmarkUpload(unsigned int width, unsigned int height)
+{
+    sf::Context context;
+    sf::Texture texture;
+
+    if (!texture.create(width, height))
+        return;
+
+    std::vector<sf::Uint8> pixels((std::size_t)width * height * 4, 128);
+    std::vector<sf::Uint8> tile(TILE_SIZE * TILE_SIZE * 4);
+    unsigned int iterations;
+
+    double seconds(measure([&]
+    {
+        texture.update(pixels.data());
+    }, iterations));
+
+    addResult("textureUpload", { { "mode", "full" }, { "width", std::to_string(width) }, { "height", std::to_string(height) } },
+        iterations, seconds, (double)width * height, "pixels");
+
+    // Dirty rectangle path: every tile packed then uploaded on its own
+    seconds = measure([&]
+    {
+        for (unsigned int y(0); y + TILE_SIZE <= height; y += TILE_SIZE)
+        {
+            for (unsigned int x(0); x + TILE_SIZE <= width; x += TILE_SIZE)
+            {
+                for (unsigned int row(0); row < TILE_SIZE; row++)
+                    std::memcpy(tile.data() + row * TILE_SIZE * 4, pixels.data() + ((y + row) * width + x) * 4, TILE_SIZE * 4);
+
+                texture.update(tile.data(), TILE_SIZE, TILE_SIZE, x, y);
+            }
+        }
+    }, iterations);
+
+    addResult("textureUpload", { { "mode", "tiles" }, { "width", std::to_string(width) }, { "height", std::to_string(height) } },
+        iterations, seconds, (double)(width / TILE_SIZE) * (height / TILE_SIZE) * TILE_SIZE * TILE_SIZE, "pixels");
+
+    // The previous path: a full image rebuilt, then loaded into the texture
+    sf::Image image;
+
+    seconds = measure([&]
+    {
+        image.create(width, height, pixels.data());
+        texture.loadFromImage(image);
+    }, iterations);
+
+    addResult("textureUpload", { { "mode", "image" }, { "width", std::to_string(width) }, { "height", std::to_string(height) } },
+        iterations, seconds, (double)width * height, "pixels");
+}
+
+static std::string escape(const std::string& text)
+{
+    std::string escaped;
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+static bool isNumber(const std::string& text)
+{
+    char* end(nullptr);
+    strtod(text.c_str(), &end);
+
+    return !text.empty() && end == text.c_str() + text.size();
+}
+
+static std::string toJson(unsigned int hardwareThreads)
+{
+    std::ostringstream json;
+    json.precision(9);
+
+    json << "{\n";
+    json << "  \"simd\": \"" << Simd::name(Simd::detectLevel()) << "\",\n";
+    json << "  \"hardwareThreads\": " << hardwareThreads << ",\n";
+    json << "  \"minTime\": " << minTime << ",\n";
+    json << "  \"results\": [\n";
+
+    for (unsigned int i(0); i < results.size(); i++)
+    {
+        const Result& result(results[i]);
+
+        json << "    { \"name\": \"" << escape(result.name) << "\"";
+
+        for (unsigned int p(0); p < result.parameters.size(); p++)
+        {
+            const std::string& value(result.parameters[p].second);
+
+            json << ", \"" << escape(result.parameters[p].first) << "\": ";
+            json << (isNumber(value) ? value : "\"" + escape(value) + "\"");
+        }
+
+        json << ", \"iterations\": " << result.iterations;
+        json << ", \"seconds\": " << result.seconds;
+        json << ", \"" << escape(result.itemName) << "PerSecond\": " << result.itemsPerSecond << " }";
+        json << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    json << "  ]\n}\n";
+
+    return json.str();
+}
+
+int main(int argc, char* argv[])
+{
+    bool quick(false), upload(true);
+    std::string output;
+
+    for (int i(1); i < argc; i++)
+    {
+        std::string argument(argv[i]);
+
+        if (argument == "--quick")
+            quick = true;
+        else if (argument == "--no-upload")
+            upload = false;
+        else if (argument == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--no-upload] [--output results.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (quick)
+        minTime = BENCHMARK_QUICK_MIN_TIME;
+
+    unsigned int hardwareThreads(std::max(std::thread::hardware_concurrency(), 1u));
+
+    std::vector<sf::Vector2u> resolutions = { { 640, 360 }, { 1280, 720 } };
+    if (!quick)
+    {
+        resolutions.push_back({ 1920, 1080 });
+        resolutions.push_back({ 3840, 2160 });
+    }
+
+    // Powers of two up to the hardware, then the hardware itself
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads(1); threads < hardwareThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
+
+    for (const sf::Vector2u& resolution : resolutions)
+    {
+        for (unsigned int threads : threadCounts)
+        {
+            benchmarkCompute<SolidKernel>("solid", resolution.x, resolution.y, threads);
+            benchmarkCompute<MandelbrotKernel>("mandelbrot", resolution.x, resolution.y, threads);
+        }
+    }
+
+    // Same view, kernel called only where the image changes
+    benchmarkCompute<MandelbrotKernel>("mandelbrot", DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT, hardwareThreads, ADAPTIVE_DEFAULT_DEPTH);
+
+    benchmarkMapping();
+    benchmarkPixelStore(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT);
+    benchmarkDetile(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT);
+    benchmarkDetile(3840, 2160);
+    benchmarkGrid();
+
+    if (upload && contextAvailable())
+        benchmarkUpload(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT);
+    else
+        std::cerr << "textureUpload: skipped, no display to create a context on" << std::endl;
+
+    std::string json(toJson(hardwareThreads));
+
+    if (output.empty())
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream file(output);
+        file << json;
+
+        if (!file)
+        {
+            std::cerr << "Could not write " << output << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
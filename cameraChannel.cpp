@@ -0,0 +1,59 @@
+#include <chrono>
+
+#include "cameraChannel.h"
+
+CameraChannel::CameraChannel()
+{
+	m_generation = 0;
+	m_closed = false;
+}
+
+void CameraChannel::submit(const Camera& camera)
+{
+	m_mutex.lock();
+
+	m_camera = camera;
+	m_camera.generation = m_generation.load() + 1;
+	m_generation = m_camera.generation;
+
+	m_mutex.unlock();
+
+	m_condition.notify_all();
+}
+
+void CameraChannel::close()
+{
+	m_mutex.lock();
+	m_closed = true;
+	m_mutex.unlock();
+
+	m_condition.notify_all();
+}
+
+bool CameraChannel::wait(unsigned long long seenGeneration)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this, seenGeneration] { return m_closed || m_generation.load() != seenGeneration; });
+
+	return !m_closed;
+}
+
+bool CameraChannel::wait(unsigned long long seenGeneration, float timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait_for(lock, std::chrono::duration<float>(timeout), [this, seenGeneration] { return m_closed || m_generation.load() != seenGeneration; });
+
+	return !m_closed;
+}
+
+Camera CameraChannel::latest() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_camera;
+}
+
+unsigned long long CameraChannel::getGeneration() const
+{
+	return m_generation.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#define DEFAULT_WIN_WIDTH 1280
+#define DEFAULT_WIN_HEIGHT 720
+
+/*
+- The window submits the whole camera at once, each submission gets the next generation number
+- A camera is never modified once submitted: the compute side renders a copy, tagged with its generation
+- Submissions the compute side has not picked up yet are replaced, so a burst of moves renders only the latest view
+- The compute thread sleeps in wait() until there is a newer generation (or a timeout, to poll something else), and polls getGeneration() per tile to cancel
+*/
+
+struct Bounds
+{
+	float xMin;
+	float xMax;
+
+	float yMin;
+	float yMax;
+};
+
+struct Camera
+{
+	Bounds bounds = { 0.f, 0.f, 0.f, 0.f };
+	unsigned int windowWidth = DEFAULT_WIN_WIDTH;
+	unsigned int windowHeight = DEFAULT_WIN_HEIGHT;
+	bool interacting = false;
+
+	unsigned long long generation = 0;
+};
+
+class CameraChannel
+{
+	public:
+		CameraChannel();
+
+		// Window thread
+		void submit(const Camera& camera);
+		void close();
+
+		// Compute thread
+		bool wait(unsigned long long seenGeneration);
+		bool wait(unsigned long long seenGeneration, float timeout);		// Also returns after timeout seconds
+		Camera latest() const;
+		unsigned long long getGeneration() const;
+
+	private:
+		Camera m_camera;
+		std::atomic<unsigned long long> m_generation;
+		bool m_closed;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_condition;
+};
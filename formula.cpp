@@ -0,0 +1,1085 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include "formula.h"
+
+enum class FormulaOp : unsigned char
+{
+	// Batch operations: d = f(a, b, c) on every pixel of the batch
+	MOVE = 0, BLEND, SELECT,
+	ADD, SUB, MUL, DIV, MOD, POW, NEG,
+	LT, LE, GT, GE, EQ, NE, AND, OR, NOT,
+	MIN, MAX, ABS, SQRT, FLOOR, CEIL,
+	SIN, COS, TAN, ASIN, ACOS, ATAN, ATAN2, EXP, LOG,
+
+	// Control flow, once per batch
+	JUMP, SKIP_IF_NONE, LOOP_RESET, LOOP_TEST
+};
+
+// x and y are loaded into the first two registers
+#define FORMULA_REGISTER_X 0
+#define FORMULA_REGISTER_Y 1
+
+struct FormulaFunction
+{
+	const char* name;
+	unsigned int arguments;
+	FormulaOp op;
+};
+
+static const FormulaFunction FUNCTIONS[] =
+{
+	{ "sin", 1, FormulaOp::SIN }, { "cos", 1, FormulaOp::COS }, { "tan", 1, FormulaOp::TAN },
+	{ "asin", 1, FormulaOp::ASIN }, { "acos", 1, FormulaOp::ACOS }, { "atan", 1, FormulaOp::ATAN },
+	{ "exp", 1, FormulaOp::EXP }, { "log", 1, FormulaOp::LOG }, { "sqrt", 1, FormulaOp::SQRT },
+	{ "abs", 1, FormulaOp::ABS }, { "floor", 1, FormulaOp::FLOOR }, { "ceil", 1, FormulaOp::CEIL },
+	{ "min", 2, FormulaOp::MIN }, { "max", 2, FormulaOp::MAX }, { "pow", 2, FormulaOp::POW },
+	{ "atan2", 2, FormulaOp::ATAN2 }, { "mod", 2, FormulaOp::MOD }
+};
+
+// Batch functions, one per operation and instruction set; registers are SIMD_ALIGNMENT aligned, counts a multiple of SIMD_MAX_WIDTH
+#define FORMULA_BATCH_FUNCTION(name) \
+	static void name([[maybe_unused]] float* d, [[maybe_unused]] const float* a, [[maybe_unused]] const float* b, [[maybe_unused]] const float* c, unsigned int count)
+
+#define FORMULA_SCALAR(name, expression) \
+	FORMULA_BATCH_FUNCTION(name##Scalar) \
+	{ \
+		for (unsigned int i(0); i < count; i++) \
+			d[i] = expression; \
+	}
+
+FORMULA_SCALAR(move, a[i])
+FORMULA_SCALAR(blend, b[i] != 0.f ? a[i] : d[i])
+FORMULA_SCALAR(select, a[i] != 0.f ? b[i] : c[i])
+FORMULA_SCALAR(add, a[i] + b[i])
+FORMULA_SCALAR(sub, a[i] - b[i])
+FORMULA_SCALAR(mul, a[i] * b[i])
+FORMULA_SCALAR(div, a[i] / b[i])
+FORMULA_SCALAR(mod, std::fmod(a[i], b[i]))
+FORMULA_SCALAR(pow, std::pow(a[i], b[i]))
+FORMULA_SCALAR(neg, -a[i])
+FORMULA_SCALAR(lt, a[i] < b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(le, a[i] <= b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(gt, a[i] > b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(ge, a[i] >= b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(eq, a[i] == b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(ne, a[i] != b[i] ? 1.f : 0.f)
+FORMULA_SCALAR(and, a[i] != 0.f && b[i] != 0.f ? 1.f : 0.f)
+FORMULA_SCALAR(or, a[i] != 0.f || b[i] != 0.f ? 1.f : 0.f)
+FORMULA_SCALAR(not, a[i] == 0.f ? 1.f : 0.f)
+FORMULA_SCALAR(min, a[i] < b[i] ? a[i] : b[i])
+FORMULA_SCALAR(max, a[i] > b[i] ? a[i] : b[i])
+FORMULA_SCALAR(abs, std::fabs(a[i]))
+FORMULA_SCALAR(sqrt, std::sqrt(a[i]))
+FORMULA_SCALAR(floor, std::floor(a[i]))
+FORMULA_SCALAR(ceil, std::ceil(a[i]))
+FORMULA_SCALAR(sin, std::sin(a[i]))
+FORMULA_SCALAR(cos, std::cos(a[i]))
+FORMULA_SCALAR(tan, std::tan(a[i]))
+FORMULA_SCALAR(asin, std::asin(a[i]))
+FORMULA_SCALAR(acos, std::acos(a[i]))
+FORMULA_SCALAR(atan, std::atan(a[i]))
+FORMULA_SCALAR(atan2, std::atan2(a[i], b[i]))
+FORMULA_SCALAR(exp, std::exp(a[i]))
+FORMULA_SCALAR(log, std::log(a[i]))
+
+#ifdef SIMD_X86
+// Same results as the scalar versions, NaN included: != 0 is true for NaN, min / max return b when either is NaN
+#define FORMULA_AVX2(name, expression) \
+	SIMD_TARGET("avx2") FORMULA_BATCH_FUNCTION(name##Avx2) \
+	{ \
+		[[maybe_unused]] const __m256 one(_mm256_set1_ps(1.f)), zero(_mm256_setzero_ps()), sign(_mm256_set1_ps(-0.f)); \
+		\
+		for (unsigned int i(0); i < count; i += 8) \
+		{ \
+			[[maybe_unused]] __m256 va(_mm256_load_ps(a + i)), vb(_mm256_load_ps(b + i)), vc(_mm256_load_ps(c + i)), vd(_mm256_load_ps(d + i)); \
+			_mm256_store_ps(d + i, expression); \
+		} \
+	}
+
+#define FORMULA_AVX2_TRUE(value) _mm256_cmp_ps(value, zero, _CMP_NEQ_UQ)
+
+FORMULA_AVX2(move, va)
+FORMULA_AVX2(blend, _mm256_blendv_ps(vd, va, FORMULA_AVX2_TRUE(vb)))
+FORMULA_AVX2(select, _mm256_blendv_ps(vc, vb, FORMULA_AVX2_TRUE(va)))
+FORMULA_AVX2(add, _mm256_add_ps(va, vb))
+FORMULA_AVX2(sub, _mm256_sub_ps(va, vb))
+FORMULA_AVX2(mul, _mm256_mul_ps(va, vb))
+FORMULA_AVX2(div, _mm256_div_ps(va, vb))
+FORMULA_AVX2(neg, _mm256_xor_ps(va, sign))
+FORMULA_AVX2(lt, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_LT_OQ), one))
+FORMULA_AVX2(le, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_LE_OQ), one))
+FORMULA_AVX2(gt, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_GT_OQ), one))
+FORMULA_AVX2(ge, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_GE_OQ), one))
+FORMULA_AVX2(eq, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_EQ_OQ), one))
+FORMULA_AVX2(ne, _mm256_and_ps(_mm256_cmp_ps(va, vb, _CMP_NEQ_UQ), one))
+FORMULA_AVX2(and, _mm256_and_ps(_mm256_and_ps(FORMULA_AVX2_TRUE(va), FORMULA_AVX2_TRUE(vb)), one))
+FORMULA_AVX2(or, _mm256_and_ps(_mm256_or_ps(FORMULA_AVX2_TRUE(va), FORMULA_AVX2_TRUE(vb)), one))
+FORMULA_AVX2(not, _mm256_and_ps(_mm256_cmp_ps(va, zero, _CMP_EQ_OQ), one))
+FORMULA_AVX2(min, _mm256_min_ps(va, vb))
+FORMULA_AVX2(max, _mm256_max_ps(va, vb))
+FORMULA_AVX2(abs, _mm256_andnot_ps(sign, va))
+FORMULA_AVX2(sqrt, _mm256_sqrt_ps(va))
+FORMULA_AVX2(floor, _mm256_floor_ps(va))
+FORMULA_AVX2(ceil, _mm256_ceil_ps(va))
+
+#define FORMULA_AVX512(name, expression) \
+	SIMD_TARGET("avx512f") FORMULA_BATCH_FUNCTION(name##Avx512) \
+	{ \
+		[[maybe_unused]] const __m512 one(_mm512_set1_ps(1.f)), zero(_mm512_setzero_ps()); \
+		[[maybe_unused]] const __m512i sign(_mm512_set1_epi32((int)0x80000000u)); \
+		\
+		for (unsigned int i(0); i < count; i += 16) \
+		{ \
+			[[maybe_unused]] __m512 va(_mm512_load_ps(a + i)), vb(_mm512_load_ps(b + i)), vc(_mm512_load_ps(c + i)), vd(_mm512_load_ps(d + i)); \
+			_mm512_store_ps(d + i, expression); \
+		} \
+	}
+
+#define FORMULA_AVX512_TRUE(value) _mm512_cmp_ps_mask(value, zero, _CMP_NEQ_UQ)
+#define FORMULA_AVX512_COMPARE(predicate) _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(va, vb, predicate), one)
+
+FORMULA_AVX512(move, va)
+FORMULA_AVX512(blend, _mm512_mask_blend_ps(FORMULA_AVX512_TRUE(vb), vd, va))
+FORMULA_AVX512(select, _mm512_mask_blend_ps(FORMULA_AVX512_TRUE(va), vc, vb))
+FORMULA_AVX512(add, _mm512_add_ps(va, vb))
+FORMULA_AVX512(sub, _mm512_sub_ps(va, vb))
+FORMULA_AVX512(mul, _mm512_mul_ps(va, vb))
+FORMULA_AVX512(div, _mm512_div_ps(va, vb))
+FORMULA_AVX512(neg, _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(va), sign)))
+FORMULA_AVX512(lt, FORMULA_AVX512_COMPARE(_CMP_LT_OQ))
+FORMULA_AVX512(le, FORMULA_AVX512_COMPARE(_CMP_LE_OQ))
+FORMULA_AVX512(gt, FORMULA_AVX512_COMPARE(_CMP_GT_OQ))
+FORMULA_AVX512(ge, FORMULA_AVX512_COMPARE(_CMP_GE_OQ))
+FORMULA_AVX512(eq, FORMULA_AVX512_COMPARE(_CMP_EQ_OQ))
+FORMULA_AVX512(ne, FORMULA_AVX512_COMPARE(_CMP_NEQ_UQ))
+FORMULA_AVX512(and, _mm512_maskz_mov_ps((__mmask16)(FORMULA_AVX512_TRUE(va) & FORMULA_AVX512_TRUE(vb)), one))
+FORMULA_AVX512(or, _mm512_maskz_mov_ps((__mmask16)(FORMULA_AVX512_TRUE(va) | FORMULA_AVX512_TRUE(vb)), one))
+FORMULA_AVX512(not, _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(va, zero, _CMP_EQ_OQ), one))
+FORMULA_AVX512(min, _mm512_min_ps(va, vb))
+FORMULA_AVX512(max, _mm512_max_ps(va, vb))
+FORMULA_AVX512(abs, _mm512_abs_ps(va))
+FORMULA_AVX512(sqrt, _mm512_sqrt_ps(va))
+FORMULA_AVX512(floor, _mm512_roundscale_ps(va, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC))
+FORMULA_AVX512(ceil, _mm512_roundscale_ps(va, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC))
+
+#define FORMULA_CASE(op, name) case FormulaOp::op: return level >= SimdLevel::AVX512 ? name##Avx512 : (level >= SimdLevel::AVX2 ? name##Avx2 : name##Scalar);
+#else
+#define FORMULA_CASE(op, name) case FormulaOp::op: return name##Scalar;
+#endif
+
+#define FORMULA_SCALAR_CASE(op, name) case FormulaOp::op: return name##Scalar;
+
+// A value while compiling: a folded constant, or the register holding it
+struct FormulaOperand
+{
+	bool constant = false;
+	float value = 0.f;
+	unsigned short reg = 0;
+	bool temporary = false;		// Released once used
+};
+
+// Recursive descent over the source, code is emitted as it is parsed
+class Formula::Compiler
+{
+	public:
+		Compiler(Formula& formula) : m_formula(formula), m_source(formula.m_source)
+		{
+			m_position = 0;
+			m_mask = -1;
+			m_overflow = false;
+		}
+
+		bool run(std::string& error)
+		{
+			m_formula.m_registerCount = 2;
+
+			Operand result;
+
+			if (!statements(true, &result))
+			{
+				error = "column " + std::to_string(m_position + 1) + ": " + m_error;
+				return false;
+			}
+
+			m_formula.m_result = materialize(result);
+
+			if (m_overflow)
+			{
+				error = "more than " + std::to_string(FORMULA_MAX_REGISTERS) + " registers needed";
+				return false;
+			}
+
+			return true;
+		}
+
+	private:
+		typedef FormulaOperand Operand;
+
+		// Tokens
+		void skipSpace()
+		{
+			while (m_position < m_source.size() && std::isspace((unsigned char)m_source[m_position]))
+				m_position++;
+		}
+
+		bool atEnd()
+		{
+			skipSpace();
+			return m_position >= m_source.size();
+		}
+
+		bool peek(const char* symbol)
+		{
+			skipSpace();
+			return m_source.compare(m_position, std::strlen(symbol), symbol) == 0;
+		}
+
+		bool accept(const char* symbol)
+		{
+			if (!peek(symbol))
+				return false;
+
+			m_position += std::strlen(symbol);
+			return true;
+		}
+
+		bool expect(const char* symbol)
+		{
+			return accept(symbol) || fail(std::string("expected '") + symbol + "'");
+		}
+
+		bool identifier(std::string& name)
+		{
+			skipSpace();
+
+			std::size_t end(m_position);
+
+			if (end >= m_source.size() || !(std::isalpha((unsigned char)m_source[end]) || m_source[end] == '_'))
+				return false;
+
+			while (end < m_source.size() && (std::isalnum((unsigned char)m_source[end]) || m_source[end] == '_'))
+				end++;
+
+			name = m_source.substr(m_position, end - m_position);
+			m_position = end;
+
+			return true;
+		}
+
+		bool acceptKeyword(const char* keyword)
+		{
+			std::size_t start(m_position);
+			std::string name;
+
+			if (identifier(name) && name == keyword)
+				return true;
+
+			m_position = start;
+			return false;
+		}
+
+		bool number(float& value)
+		{
+			skipSpace();
+
+			if (m_position >= m_source.size())
+				return false;
+
+			char first(m_source[m_position]);
+
+			if (!std::isdigit((unsigned char)first) && !(first == '.' && m_position + 1 < m_source.size() && std::isdigit((unsigned char)m_source[m_position + 1])))
+				return false;
+
+			const char* begin(m_source.c_str() + m_position);
+			char* end(nullptr);
+
+			value = std::strtof(begin, &end);
+			m_position += (std::size_t)(end - begin);
+
+			return true;
+		}
+
+		bool fail(const std::string& message)
+		{
+			if (m_error.empty())
+				m_error = message;
+
+			return false;
+		}
+
+		static bool isReserved(const std::string& name)
+		{
+			return name == "x" || name == "y" || name == "pi" || name == "e" || name == "if" || name == "else" || name == "iterate" || name == "while";
+		}
+
+		// Registers: x and y, then pinned ones (variables, constants, masks), temporaries are recycled
+		unsigned short pin()
+		{
+			if (m_formula.m_registerCount >= FORMULA_MAX_REGISTERS)
+			{
+				m_overflow = true;
+				return FORMULA_MAX_REGISTERS - 1;
+			}
+
+			return (unsigned short)m_formula.m_registerCount++;
+		}
+
+		unsigned short allocate()
+		{
+			if (m_free.empty())
+				return pin();
+
+			unsigned short reg(m_free.back());
+			m_free.pop_back();
+
+			return reg;
+		}
+
+		void release(const Operand& operand)
+		{
+			if (operand.temporary)
+				m_free.push_back(operand.reg);
+		}
+
+		unsigned short materialize(const Operand& operand)
+		{
+			if (!operand.constant)
+				return operand.reg;
+
+			std::uint32_t bits;
+			std::memcpy(&bits, &operand.value, sizeof(bits));
+
+			std::map<std::uint32_t, unsigned short>::iterator found(m_constants.find(bits));
+
+			if (found != m_constants.end())
+				return found->second;
+
+			unsigned short reg(pin());
+
+			m_constants[bits] = reg;
+			m_formula.m_constants.push_back({ reg, operand.value });
+
+			return reg;
+		}
+
+		static Operand constant(float value)
+		{
+			Operand operand;
+			operand.constant = true;
+			operand.value = value;
+
+			return operand;
+		}
+
+		unsigned int emit(FormulaOp op, unsigned short d, unsigned short a = 0, unsigned short b = 0, unsigned short c = 0, unsigned int target = 0)
+		{
+			m_formula.m_code.push_back({ op, d, a, b, c, target });
+
+			return (unsigned int)m_formula.m_code.size() - 1;
+		}
+
+		// Folded when every argument is a constant, otherwise written to a temporary
+		Operand operation(FormulaOp op, const Operand& a, const Operand& b = Operand(), const Operand& c = Operand(), unsigned int arguments = 1)
+		{
+			const Operand* operands[3] = { &a, &b, &c };
+			bool folded(true);
+
+			for (unsigned int i(0); i < arguments; i++)
+				folded = folded && operands[i]->constant;
+
+			if (folded)
+			{
+				float values[3] = { a.value, b.value, c.value };
+				float result(0.f);
+
+				batchFunction(op, SimdLevel::SCALAR)(&result, &values[0], &values[1], &values[2], 1);
+
+				return constant(result);
+			}
+
+			unsigned short registers[3] = { 0, 0, 0 };
+
+			for (unsigned int i(0); i < arguments; i++)
+				registers[i] = materialize(*operands[i]);
+
+			// The result may take the place of an argument, every operation works lane by lane
+			for (unsigned int i(0); i < arguments; i++)
+				release(*operands[i]);
+
+			Operand result;
+			result.reg = allocate();
+			result.temporary = true;
+
+			emit(op, result.reg, registers[0], registers[1], registers[2]);
+
+			return result;
+		}
+
+		// Statements
+		bool statements(bool topLevel, Operand* result)
+		{
+			bool hasValue(false);
+			Operand value;
+
+			while (!atEnd() && !peek("}"))
+			{
+				if (hasValue)
+					release(value);
+
+				hasValue = false;
+
+				if (acceptKeyword("if"))
+				{
+					if (!ifStatement())
+						return false;
+				}
+				else if (acceptKeyword("iterate"))
+				{
+					if (!iterateStatement())
+						return false;
+				}
+				else
+				{
+					skipSpace();
+
+					std::size_t start(m_position);
+					std::string name;
+
+					if (identifier(name) && peek("=") && !peek("=="))
+					{
+						if (isReserved(name))
+						{
+							m_position = start;
+							return fail("'" + name + "' cannot be assigned");
+						}
+
+						accept("=");
+
+						if (!assignment(name))
+							return false;
+					}
+					else
+					{
+						m_position = start;
+
+						if (!expression(value))
+							return false;
+
+						hasValue = true;
+					}
+				}
+
+				accept(";");
+			}
+
+			if (!topLevel)
+			{
+				if (hasValue)
+					release(value);
+
+				return true;
+			}
+
+			if (!atEnd())
+				return fail("unexpected '" + std::string(1, m_source[m_position]) + "'");
+
+			if (!hasValue)
+				return fail("the last statement must be the value of the pixel");
+
+			*result = value;
+
+			return true;
+		}
+
+		bool block()
+		{
+			return expect("{") && statements(false, nullptr) && expect("}");
+		}
+
+		bool assignment(const std::string& name)
+		{
+			Operand value;
+
+			if (!expression(value))
+				return false;
+
+			std::map<std::string, unsigned short>::iterator found(m_variables.find(name));
+			unsigned short variable;
+
+			if (found == m_variables.end())
+			{
+				variable = pin();
+				m_variables[name] = variable;
+				m_formula.m_variables.push_back(variable);
+			}
+			else
+			{
+				variable = found->second;
+			}
+
+			// Pixels outside the current branch or loop keep their value
+			if (m_mask < 0)
+				emit(FormulaOp::MOVE, variable, materialize(value));
+			else
+				emit(FormulaOp::BLEND, variable, materialize(value), (unsigned short)m_mask);
+
+			release(value);
+
+			return true;
+		}
+
+		bool ifStatement()
+		{
+			Operand condition;
+
+			if (!expression(condition))
+				return false;
+
+			// Both masks before the branch, which may change what the condition reads
+			unsigned short conditionRegister(materialize(condition));
+			unsigned short thenMask(pin()), elseMask(pin());
+			unsigned short notCondition(allocate());
+
+			emit(FormulaOp::AND, thenMask, m_mask < 0 ? conditionRegister : (unsigned short)m_mask, conditionRegister);
+			emit(FormulaOp::NOT, notCondition, conditionRegister);
+			emit(FormulaOp::AND, elseMask, m_mask < 0 ? notCondition : (unsigned short)m_mask, notCondition);
+
+			m_free.push_back(notCondition);
+			release(condition);
+
+			int parentMask(m_mask);
+			unsigned int skipThen(emit(FormulaOp::SKIP_IF_NONE, 0, thenMask));
+
+			m_mask = thenMask;
+			bool parsed(block());
+			m_mask = parentMask;
+
+			m_formula.m_code[skipThen].target = (unsigned int)m_formula.m_code.size();
+
+			if (!parsed || !acceptKeyword("else"))
+				return parsed;
+
+			unsigned int skipElse(emit(FormulaOp::SKIP_IF_NONE, 0, elseMask));
+
+			m_mask = elseMask;
+			parsed = acceptKeyword("if") ? ifStatement() : block();
+			m_mask = parentMask;
+
+			m_formula.m_code[skipElse].target = (unsigned int)m_formula.m_code.size();
+
+			return parsed;
+		}
+
+		bool iterateStatement()
+		{
+			float count(0.f);
+
+			if (!number(count) || count < 1.f || count > (float)FORMULA_MAX_ITERATIONS || count != std::floor(count))
+				return fail("expected an iteration count from 1 to " + std::to_string(FORMULA_MAX_ITERATIONS));
+
+			if (!acceptKeyword("while"))
+				return fail("expected 'while'");
+
+			unsigned short loopMask(pin());
+			unsigned short slot((unsigned short)m_formula.m_loopCount++);
+
+			emit(FormulaOp::MOVE, loopMask, m_mask < 0 ? materialize(constant(1.f)) : (unsigned short)m_mask);
+			emit(FormulaOp::LOOP_RESET, slot);
+
+			// The condition is evaluated again before every iteration, a pixel leaves the loop for good once it is false
+			unsigned int start((unsigned int)m_formula.m_code.size());
+			Operand condition;
+
+			if (!expression(condition))
+				return false;
+
+			emit(FormulaOp::AND, loopMask, loopMask, materialize(condition));
+			release(condition);
+
+			unsigned int test(emit(FormulaOp::LOOP_TEST, slot, loopMask, 0, (unsigned short)count));
+
+			int parentMask(m_mask);
+
+			m_mask = loopMask;
+			bool parsed(block());
+			m_mask = parentMask;
+
+			emit(FormulaOp::JUMP, 0, 0, 0, 0, start);
+			m_formula.m_code[test].target = (unsigned int)m_formula.m_code.size();
+
+			return parsed;
+		}
+
+		// Expressions, from the lowest precedence
+		bool expression(Operand& out)
+		{
+			Operand condition;
+
+			if (!logicalOr(condition))
+				return false;
+
+			if (!accept("?"))
+			{
+				out = condition;
+				return true;
+			}
+
+			Operand a, b;
+
+			if (!expression(a) || !expect(":") || !expression(b))
+				return false;
+
+			// A constant condition only keeps one side
+			if (condition.constant)
+			{
+				out = condition.value != 0.f ? a : b;
+				release(condition.value != 0.f ? b : a);
+				return true;
+			}
+
+			out = operation(FormulaOp::SELECT, condition, a, b, 3);
+			return true;
+		}
+
+		bool logicalOr(Operand& out)
+		{
+			if (!logicalAnd(out))
+				return false;
+
+			while (accept("||"))
+			{
+				Operand right;
+
+				if (!logicalAnd(right))
+					return false;
+
+				out = operation(FormulaOp::OR, out, right, Operand(), 2);
+			}
+
+			return true;
+		}
+
+		bool logicalAnd(Operand& out)
+		{
+			if (!comparison(out))
+				return false;
+
+			while (accept("&&"))
+			{
+				Operand right;
+
+				if (!comparison(right))
+					return false;
+
+				out = operation(FormulaOp::AND, out, right, Operand(), 2);
+			}
+
+			return true;
+		}
+
+		bool comparison(Operand& out)
+		{
+			if (!additive(out))
+				return false;
+
+			static const struct { const char* symbol; FormulaOp op; } COMPARISONS[] =
+			{
+				{ "<=", FormulaOp::LE }, { ">=", FormulaOp::GE }, { "==", FormulaOp::EQ }, { "!=", FormulaOp::NE }, { "<", FormulaOp::LT }, { ">", FormulaOp::GT }
+			};
+
+			for (const auto& candidate : COMPARISONS)
+			{
+				if (accept(candidate.symbol))
+				{
+					Operand right;
+
+					if (!additive(right))
+						return false;
+
+					out = operation(candidate.op, out, right, Operand(), 2);
+					return true;
+				}
+			}
+
+			return true;
+		}
+
+		bool additive(Operand& out)
+		{
+			if (!term(out))
+				return false;
+
+			while (true)
+			{
+				FormulaOp op;
+
+				if (accept("+"))
+					op = FormulaOp::ADD;
+				else if (accept("-"))
+					op = FormulaOp::SUB;
+				else
+					return true;
+
+				Operand right;
+
+				if (!term(right))
+					return false;
+
+				out = operation(op, out, right, Operand(), 2);
+			}
+		}
+
+		bool term(Operand& out)
+		{
+			if (!unary(out))
+				return false;
+
+			while (true)
+			{
+				FormulaOp op;
+
+				if (accept("*"))
+					op = FormulaOp::MUL;
+				else if (accept("/"))
+					op = FormulaOp::DIV;
+				else if (accept("%"))
+					op = FormulaOp::MOD;
+				else
+					return true;
+
+				Operand right;
+
+				if (!unary(right))
+					return false;
+
+				out = operation(op, out, right, Operand(), 2);
+			}
+		}
+
+		bool unary(Operand& out)
+		{
+			if (accept("-"))
+			{
+				if (!unary(out))
+					return false;
+
+				out = operation(FormulaOp::NEG, out);
+				return true;
+			}
+
+			if (accept("!"))
+			{
+				if (!unary(out))
+					return false;
+
+				out = operation(FormulaOp::NOT, out);
+				return true;
+			}
+
+			if (!primary(out))
+				return false;
+
+			// Right associative, and above the unary minus: -x^2 is -(x^2)
+			if (accept("^"))
+			{
+				Operand exponent;
+
+				if (!unary(exponent))
+					return false;
+
+				out = operation(FormulaOp::POW, out, exponent, Operand(), 2);
+			}
+
+			return true;
+		}
+
+		bool primary(Operand& out)
+		{
+			float value;
+
+			if (number(value))
+			{
+				out = constant(value);
+				return true;
+			}
+
+			if (accept("("))
+				return expression(out) && expect(")");
+
+			skipSpace();
+
+			std::string name;
+			std::size_t start(m_position);
+
+			if (!identifier(name))
+				return fail(atEnd() ? "unexpected end of the formula" : "unexpected '" + std::string(1, m_source[m_position]) + "'");
+
+			if (accept("("))
+				return call(name, start, out);
+
+			if (name == "x" || name == "y")
+			{
+				out = Operand();
+				out.reg = name == "x" ? FORMULA_REGISTER_X : FORMULA_REGISTER_Y;
+				return true;
+			}
+
+			if (name == "pi")
+			{
+				out = constant(3.14159265358979f);
+				return true;
+			}
+
+			if (name == "e")
+			{
+				out = constant(2.71828182845905f);
+				return true;
+			}
+
+			std::map<std::string, unsigned short>::iterator found(m_variables.find(name));
+
+			if (found == m_variables.end())
+			{
+				m_position = start;
+				return fail("unknown variable '" + name + "'");
+			}
+
+			out = Operand();
+			out.reg = found->second;
+
+			return true;
+		}
+
+		bool call(const std::string& name, std::size_t start, Operand& out)
+		{
+			const FormulaFunction* function(nullptr);
+
+			for (const FormulaFunction& candidate : FUNCTIONS)
+			{
+				if (name == candidate.name)
+					function = &candidate;
+			}
+
+			if (function == nullptr)
+			{
+				m_position = start;
+				return fail("unknown function '" + name + "'");
+			}
+
+			Operand arguments[2];
+
+			for (unsigned int i(0); i < function->arguments; i++)
+			{
+				if ((i > 0 && !expect(",")) || !expression(arguments[i]))
+					return false;
+			}
+
+			if (!expect(")"))
+				return false;
+
+			out = operation(function->op, arguments[0], arguments[1], Operand(), function->arguments);
+
+			return true;
+		}
+
+		Formula& m_formula;
+		const std::string& m_source;
+		std::size_t m_position;
+		std::string m_error;
+
+		std::map<std::string, unsigned short> m_variables;
+		std::map<std::uint32_t, unsigned short> m_constants;		// By bit pattern
+		std::vector<unsigned short> m_free;
+		int m_mask;		// Register of the pixels the current branch or loop applies to, -1 for all of them
+		bool m_overflow;
+};
+
+Formula::Formula()
+{
+	m_compiled = false;
+	m_registerCount = 0;
+	m_loopCount = 0;
+	m_result = 0;
+}
+
+bool Formula::compile(const std::string& source, std::string& error)
+{
+	// Built aside, a formula that does not compile leaves this one as it was
+	Formula compiled;
+	compiled.m_source = source;
+
+	Compiler compiler(compiled);
+
+	if (!compiler.run(error))
+		return false;
+
+	for (unsigned int level(0); level < 4; level++)
+	{
+		for (unsigned int i(0); i < compiled.m_code.size(); i++)
+			compiled.m_functions[level].push_back(batchFunction(compiled.m_code[i].op, (SimdLevel)level));
+	}
+
+	compiled.m_compiled = true;
+	*this = compiled;
+
+	return true;
+}
+
+bool Formula::isCompiled() const
+{
+	return m_compiled;
+}
+
+const std::string& Formula::getSource() const
+{
+	return m_source;
+}
+
+unsigned int Formula::getInstructionCount() const
+{
+	return (unsigned int)m_code.size();
+}
+
+unsigned int Formula::getRegisterCount() const
+{
+	return m_registerCount;
+}
+
+void Formula::evaluate(SimdLevel level, const PixelRow& row, float* out) const
+{
+	alignas(SIMD_ALIGNMENT) static thread_local float registers[FORMULA_MAX_REGISTERS][FORMULA_BATCH_SIZE];
+	static thread_local std::vector<unsigned int> counters;
+
+	if (!m_compiled)
+	{
+		std::fill(out, out + row.count, std::nanf(""));
+		return;
+	}
+
+	counters.resize(m_loopCount);
+
+	const Instruction* code(m_code.data());
+	const BatchFunction* functions(m_functions[(int)level].data());
+	unsigned int size((unsigned int)m_code.size());
+
+	for (unsigned int first(0); first < row.count; first += FORMULA_BATCH_SIZE)
+	{
+		unsigned int count(std::min(row.count - first, (unsigned int)FORMULA_BATCH_SIZE));
+
+		// Whole vectors: the row coordinates are padded to a multiple of SIMD_MAX_WIDTH
+		unsigned int lanes((count + SIMD_MAX_WIDTH - 1) / SIMD_MAX_WIDTH * SIMD_MAX_WIDTH);
+
+		std::memcpy(registers[FORMULA_REGISTER_X], row.x + first, lanes * sizeof(float));
+		std::fill(registers[FORMULA_REGISTER_Y], registers[FORMULA_REGISTER_Y] + lanes, row.y);
+
+		for (unsigned int i(0); i < m_constants.size(); i++)
+			std::fill(registers[m_constants[i].reg], registers[m_constants[i].reg] + lanes, m_constants[i].value);
+
+		for (unsigned int i(0); i < m_variables.size(); i++)
+			std::fill(registers[m_variables[i]], registers[m_variables[i]] + lanes, 0.f);
+
+		unsigned int pc(0);
+
+		while (pc < size)
+		{
+			const Instruction& instruction(code[pc]);
+
+			if (functions[pc] != nullptr)
+			{
+				functions[pc](registers[instruction.d], registers[instruction.a], registers[instruction.b], registers[instruction.c], lanes);
+				pc++;
+				continue;
+			}
+
+			// Only the real pixels decide, not the padding
+			const float* mask(registers[instruction.a]);
+			bool any(std::any_of(mask, mask + count, [](float value) { return value != 0.f; }));
+
+			switch (instruction.op)
+			{
+				case FormulaOp::JUMP:
+					pc = instruction.target;
+					break;
+
+				case FormulaOp::SKIP_IF_NONE:
+					pc = any ? pc + 1 : instruction.target;
+					break;
+
+				case FormulaOp::LOOP_RESET:
+					counters[instruction.d] = 0;
+					pc++;
+					break;
+
+				case FormulaOp::LOOP_TEST:
+					if (any && counters[instruction.d] < instruction.c)
+					{
+						counters[instruction.d]++;
+						pc++;
+					}
+					else
+					{
+						pc = instruction.target;
+					}
+					break;
+
+				default:
+					pc++;
+					break;
+			}
+		}
+
+		std::memcpy(out + first, registers[m_result], count * sizeof(float));
+	}
+}
+
+// PRIVATE
+Formula::BatchFunction Formula::batchFunction(FormulaOp op, SimdLevel level)
+{
+	(void)level;
+
+	switch (op)
+	{
+		FORMULA_CASE(MOVE, move)
+		FORMULA_CASE(BLEND, blend)
+		FORMULA_CASE(SELECT, select)
+		FORMULA_CASE(ADD, add)
+		FORMULA_CASE(SUB, sub)
+		FORMULA_CASE(MUL, mul)
+		FORMULA_CASE(DIV, div)
+		FORMULA_SCALAR_CASE(MOD, mod)
+		FORMULA_SCALAR_CASE(POW, pow)
+		FORMULA_CASE(NEG, neg)
+		FORMULA_CASE(LT, lt)
+		FORMULA_CASE(LE, le)
+		FORMULA_CASE(GT, gt)
+		FORMULA_CASE(GE, ge)
+		FORMULA_CASE(EQ, eq)
+		FORMULA_CASE(NE, ne)
+		FORMULA_CASE(AND, and)
+		FORMULA_CASE(OR, or)
+		FORMULA_CASE(NOT, not)
+		FORMULA_CASE(MIN, min)
+		FORMULA_CASE(MAX, max)
+		FORMULA_CASE(ABS, abs)
+		FORMULA_CASE(SQRT, sqrt)
+		FORMULA_CASE(FLOOR, floor)
+		FORMULA_CASE(CEIL, ceil)
+		FORMULA_SCALAR_CASE(SIN, sin)
+		FORMULA_SCALAR_CASE(COS, cos)
+		FORMULA_SCALAR_CASE(TAN, tan)
+		FORMULA_SCALAR_CASE(ASIN, asin)
+		FORMULA_SCALAR_CASE(ACOS, acos)
+		FORMULA_SCALAR_CASE(ATAN, atan)
+		FORMULA_SCALAR_CASE(ATAN2, atan2)
+		FORMULA_SCALAR_CASE(EXP, exp)
+		FORMULA_SCALAR_CASE(LOG, log)
+		default:
+			return nullptr;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "simd.h"
+
+// Pixels evaluated per instruction dispatch, longer rows are cut into batches
+#define FORMULA_BATCH_SIZE 64
+
+// Registers of a program (x, y, variables, constants, masks, temporaries), iterations of a single loop
+#define FORMULA_MAX_REGISTERS 256
+#define FORMULA_MAX_ITERATIONS 65535
+
+/*
+- A formula gives one value per pixel from x and y, as statements separated by ';', the last one being the value:
+    zx = 0; zy = 0; n = 0;
+    iterate 256 while zx * zx + zy * zy < 4 { t = zx * zx - zy * zy + x; zy = 2 * zx * zy + y; zx = t; n = n + 1 }
+    n / 256
+- Expressions: + - * / % ^, comparisons, && || ! (giving 1 or 0), c ? a : b, pi, e, and the functions listed in formula.cpp
+- "if c { ... } else { ... }" and "iterate N while c { ... }", which runs at most N times, per pixel as long as c holds
+- compile() turns the source into a register bytecode, constant expressions are folded
+- Each instruction runs over a whole batch of pixels, so the dispatch cost is shared by FORMULA_BATCH_SIZE pixels
+- Branches and loops are masked per pixel, a batch leaves a loop once none of its pixels is still in it
+- Arithmetic and comparisons use AVX2 or AVX-512 when the CPU has them, transcendental functions stay scalar
+- evaluate() can be called from any number of threads at once
+*/
+
+enum class FormulaOp : unsigned char;
+
+class Formula
+{
+	public:
+		Formula();
+
+		bool compile(const std::string& source, std::string& error);
+
+		bool isCompiled() const;
+		const std::string& getSource() const;
+		unsigned int getInstructionCount() const;
+		unsigned int getRegisterCount() const;
+
+		void evaluate(SimdLevel level, const PixelRow& row, float* out) const;
+
+	private:
+		class Compiler;
+
+		typedef void (*BatchFunction)(float* d, const float* a, const float* b, const float* c, unsigned int count);
+
+		struct Instruction
+		{
+			FormulaOp op;
+			unsigned short d;
+			unsigned short a;
+			unsigned short b;
+			unsigned short c;
+			unsigned int target;		// Jumps: instruction to go to
+		};
+
+		struct Constant
+		{
+			unsigned short reg;
+			float value;
+		};
+
+		static BatchFunction batchFunction(FormulaOp op, SimdLevel level);
+
+		std::string m_source;
+		bool m_compiled;
+
+		std::vector<Instruction> m_code;
+		std::vector<BatchFunction> m_functions[4];		// Per SimdLevel, nullptr for control flow
+		std::vector<Constant> m_constants;
+		std::vector<unsigned short> m_variables;		// Zeroed before each batch
+		unsigned int m_registerCount;
+		unsigned int m_loopCount;
+		unsigned short m_result;
+};
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "frameBuffer.h"
+
+void Frame::resize(unsigned int newWidth, unsigned int newHeight)
+{
+	// The spare tile column and row let any phase fit
+	tilesX = (newWidth + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE + 1;
+	tilesY = (newHeight + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE + 1;
+
+	unsigned int size(tilesX * tilesY * FRAME_TILE_SIZE * FRAME_TILE_SIZE);
+
+	if (size > capacity)
+	{
+		reserve(std::max(size, (unsigned int)(capacity * FRAME_GROWTH_FACTOR)));
+	}
+	else if (size < capacity / 2)
+	{
+		// A resize drag goes back and forth, only a frame that stays small gives its storage back
+		if (!oversized)
+		{
+			oversized = true;
+			oversizedSince = std::chrono::steady_clock::now();
+		}
+		else if (std::chrono::duration<float>(std::chrono::steady_clock::now() - oversizedSince).count() >= FRAME_SHRINK_DELAY)
+		{
+			reserve(size);
+		}
+	}
+	else
+	{
+		oversized = false;
+	}
+
+	width = newWidth;
+	height = newHeight;
+}
+
+void Frame::reserve(unsigned int pixelCount)
+{
+	// The content is not kept, every caller fills the frame again
+	std::size_t bytes;
+
+	FramePool::global().release(pixels, (std::size_t)capacity * 4);
+	pixels = FramePool::global().acquire((std::size_t)pixelCount * 4, bytes);
+
+	capacity = (unsigned int)(bytes / 4);
+	oversized = false;
+}
+
+void Frame::release()
+{
+	FramePool::global().release(pixels, (std::size_t)capacity * 4);
+
+	pixels = nullptr;
+	capacity = 0;
+	oversized = false;
+}
+
+void Frame::setPhase(unsigned int newPhaseX, unsigned int newPhaseY)
+{
+	// Only moves the tile grid, the pixels have to be filled again
+	phaseX = newPhaseX % FRAME_TILE_SIZE;
+	phaseY = newPhaseY % FRAME_TILE_SIZE;
+}
+
+void Frame::fill(sf::Color color)
+{
+	sf::Color* first(reinterpret_cast<sf::Color*>(pixels));
+
+	std::fill(first, first + tilesX * tilesY * FRAME_TILE_SIZE * FRAME_TILE_SIZE, color);
+}
+
+void Frame::copyFrom(const Frame& other)
+{
+	resize(other.width, other.height);
+	phaseX = other.phaseX;
+	phaseY = other.phaseY;
+	scale = other.scale;
+	offset = other.offset;
+	sequence = other.sequence;
+
+	if (other.pixels != nullptr)
+		std::memcpy(pixels, other.pixels, (std::size_t)tilesX * tilesY * FRAME_TILE_SIZE * FRAME_TILE_SIZE * 4);
+}
+
+void Frame::copyFrom(const Frame& other, const sf::IntRect& rect)
+{
+	int right(rect.left + rect.width);
+
+	// Same layout, a run of a tile row is at the same offset in both frames
+	for (int y(rect.top); y < rect.top + rect.height; y++)
+	{
+		std::size_t row(rowOffset((unsigned int)y));
+
+		for (int x(rect.left); x < right;)
+		{
+			int run(std::min(FRAME_TILE_SIZE - (int)((x + phaseX) % FRAME_TILE_SIZE), right - x));
+			std::size_t first((row + columnOffset((unsigned int)x)) * 4);
+
+			std::memcpy(pixels + first, other.pixels + first, (std::size_t)run * 4);
+			x += run;
+		}
+	}
+}
+
+void Frame::scroll(int offsetX, int offsetY)
+{
+	// The pixel at (x, y) moves to (x - offsetX, y - offsetY), the exposed pixels keep stale values
+	int tileSize(FRAME_TILE_SIZE);
+	int shiftedX((int)phaseX + offsetX), shiftedY((int)phaseY + offsetY);
+	int tileShiftX((shiftedX - ((shiftedX % tileSize) + tileSize) % tileSize) / tileSize);
+	int tileShiftY((shiftedY - ((shiftedY % tileSize) + tileSize) % tileSize) / tileSize);
+
+	// A pixel keeps its place in its tile, the phase takes the part of the offset smaller than a tile
+	phaseX = (unsigned int)(shiftedX - tileShiftX * tileSize);
+	phaseY = (unsigned int)(shiftedY - tileShiftY * tileSize);
+
+	// The other part moves whole tiles, all by the same distance in memory: a single move.
+	// Tiles wrapping around a tile row only land where the pixels are exposed
+	long long shift((long long)tileShiftY * tilesX + tileShiftX);
+	long long tileCount((long long)tilesX * tilesY);
+	std::size_t tileBytes(FRAME_TILE_SIZE * FRAME_TILE_SIZE * 4);
+
+	if (shift == 0 || shift >= tileCount || -shift >= tileCount)
+		return;
+
+	if (shift > 0)
+		std::memmove(pixels, pixels + shift * tileBytes, (std::size_t)(tileCount - shift) * tileBytes);
+	else
+		std::memmove(pixels - shift * tileBytes, pixels, (std::size_t)(tileCount + shift) * tileBytes);
+}
+
+void Frame::copyRegion(const sf::IntRect& rect, sf::Uint8* out) const
+{
+	int right(rect.left + rect.width);
+
+	// Rows are gathered from contiguous runs of up to a whole tile row (FRAME_TILE_SIZE * 4 bytes)
+	for (int y(rect.top); y < rect.top + rect.height; y++)
+	{
+		const sf::Uint8* row(pixels + (std::size_t)rowOffset((unsigned int)y) * 4);
+
+		for (int x(rect.left); x < right;)
+		{
+			int run(std::min(FRAME_TILE_SIZE - (int)((x + phaseX) % FRAME_TILE_SIZE), right - x));
+
+			std::memcpy(out, row + (std::size_t)columnOffset((unsigned int)x) * 4, (std::size_t)run * 4);
+			out += run * 4;
+			x += run;
+		}
+	}
+}
+
+FrameBuffer::FrameBuffer()
+{
+	m_back = 0;
+	m_pending = 1;
+	m_front = 2;
+
+	m_backAllDirty = true;
+	m_sequence = 0;
+	m_syncAllSequence = 0;
+	m_allDirtySequence = 0;
+	m_shownSequence = 0;
+}
+
+FrameBuffer::~FrameBuffer()
+{
+	for (unsigned int i(0); i < 3; i++)
+		m_frames[i].release();
+}
+
+Frame& FrameBuffer::back()
+{
+	return m_frames[m_back];
+}
+
+void FrameBuffer::markDirty(const sf::IntRect& rect)
+{
+	if (!m_backAllDirty && rect.width > 0 && rect.height > 0)
+		m_backDirty.push_back(rect);
+}
+
+void FrameBuffer::markAllDirty()
+{
+	m_backAllDirty = true;
+	m_backDirty.clear();
+}
+
+void FrameBuffer::publish()
+{
+	unsigned int published(m_back);
+
+	m_sequence++;
+	m_frames[published].sequence = m_sequence;
+
+	// Logged before the frame goes out, so the window never sees a frame without its rectangles
+	m_dirtyMutex.lock();
+
+	if (m_backAllDirty || m_dirtyLog.size() + m_backDirty.size() > FRAME_DIRTY_LOG_LIMIT)
+	{
+		m_allDirtySequence = m_sequence;
+		m_dirtyLog.clear();
+	}
+	else
+	{
+		for (unsigned int i(0); i < m_backDirty.size(); i++)
+			m_dirtyLog.push_back({ m_sequence, m_backDirty[i] });
+	}
+
+	m_dirtyMutex.unlock();
+
+	if (m_backAllDirty || m_syncLog.size() + m_backDirty.size() > FRAME_DIRTY_LOG_LIMIT)
+	{
+		m_syncAllSequence = m_sequence;
+		m_syncLog.clear();
+	}
+	else
+	{
+		for (unsigned int i(0); i < m_backDirty.size(); i++)
+			m_syncLog.push_back({ m_sequence, m_backDirty[i] });
+	}
+
+	m_backDirty.clear();
+	m_backAllDirty = false;
+
+	m_back = m_pending.exchange(published | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+
+	// The published frame is only read from now on, whether the window has picked it up or not.
+	// The new back frame is as it was published last, it misses what changed since then
+	Frame& back(m_frames[m_back]);
+	const Frame& source(m_frames[published]);
+	unsigned long long since(back.sequence);
+
+	if (since < m_syncAllSequence || back.width != source.width || back.height != source.height || back.phaseX != source.phaseX || back.phaseY != source.phaseY)
+	{
+		back.copyFrom(source);
+	}
+	else
+	{
+		for (unsigned int i(0); i < m_syncLog.size(); i++)
+		{
+			if (m_syncLog[i].sequence > since)
+				back.copyFrom(source, m_syncLog[i].rect);
+		}
+
+		back.scale = source.scale;
+		back.offset = source.offset;
+		back.sequence = source.sequence;
+	}
+
+	// Only the other two frames can come back, and only their sequences are written here (the window reads them)
+	unsigned long long oldest(m_sequence);
+
+	for (unsigned int i(0); i < 3; i++)
+	{
+		if (i != m_back)
+			oldest = std::min(oldest, m_frames[i].sequence);
+	}
+
+	m_syncLog.erase(std::remove_if(m_syncLog.begin(), m_syncLog.end(), [oldest](const DirtyRegion& region) { return region.sequence <= oldest; }), m_syncLog.end());
+}
+
+bool FrameBuffer::isFresh() const
+{
+	return (m_pending.load(std::memory_order_relaxed) & FRESH_BIT) != 0;
+}
+
+bool FrameBuffer::acquire()
+{
+	if (!(m_pending.load(std::memory_order_relaxed) & FRESH_BIT))
+		return false;
+
+	m_front = m_pending.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+
+	return true;
+}
+
+const Frame& FrameBuffer::front() const
+{
+	return m_frames[m_front];
+}
+
+bool FrameBuffer::takeDirtyRegions(std::vector<sf::IntRect>& regions)
+{
+	std::lock_guard<std::mutex> lock(m_dirtyMutex);
+
+	unsigned long long shown(m_frames[m_front].sequence);
+	bool partial(m_allDirtySequence <= m_shownSequence);
+
+	// Frames are acquired in publish order, everything up to the front frame has been logged and not taken yet
+	regions.clear();
+	unsigned int kept(0);
+
+	for (unsigned int i(0); i < m_dirtyLog.size(); i++)
+	{
+		if (m_dirtyLog[i].sequence > shown)
+			m_dirtyLog[kept++] = m_dirtyLog[i];
+		else if (partial)
+			regions.push_back(m_dirtyLog[i].rect);
+	}
+
+	m_dirtyLog.resize(kept);
+	m_shownSequence = shown;
+
+	return partial;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "framePool.h"
+
+// Past this many dirty rectangles waiting for the window, the whole frame is uploaded instead
+#define FRAME_DIRTY_LOG_LIMIT 4096
+
+// Frames are stored in square tiles of this many pixels, each tile contiguous and its rows one after the other
+#define FRAME_TILE_SIZE 64
+
+// A frame outgrowing its storage asks for this much more than it needs, so a window dragged bigger reallocates a few times only
+#define FRAME_GROWTH_FACTOR 1.5f
+
+// Storage more than twice the frame size is given back once it has been for this many seconds
+#define FRAME_SHRINK_DELAY 2.f
+
+/*
+- Triple buffer: the compute side owns the back frame, the window owns the front frame
+- publish() hands the back frame over with a single atomic exchange, neither side ever waits
+- After a publish the new back frame is brought up to date, so an unfinished frame can be published and resumed:
+  only the rectangles published since it was last the back frame are copied, the whole frame after a markAllDirty()
+- The compute side marks what it changed, the window gets every rectangle changed since the frame it showed last
+- Frame pixels are tiled: the phase is where pixel (0, 0) sits in its tile, so the tiles can follow a grid that is not the frame's
+- Scrolling keeps every pixel at the same place in its tile, only whole tiles move
+- copyRegion() turns a rectangle back into rows, for the texture upload
+- Storage comes from the FramePool, aligned, and goes back to it with release(): resizing in steady state allocates nothing
+*/
+
+struct Frame
+{
+	sf::Uint8* pixels = nullptr;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int capacity = 0;						// In pixels, may be more than the tiles need
+	unsigned int tilesX = 0;						// One more than the width needs, whatever the phase
+	unsigned int tilesY = 0;
+	unsigned int phaseX = 0;						// Position of pixel (0, 0) in its tile
+	unsigned int phaseY = 0;
+	sf::Vector2f scale = sf::Vector2f(1.f, 1.f);	// Window pixels per frame pixel
+	sf::Vector2f offset;							// Window position of the first frame pixel
+	unsigned long long sequence = 0;				// Number of the publish that made this frame
+	bool oversized = false;							// Using less than half of the capacity, since oversizedSince
+	std::chrono::steady_clock::time_point oversizedSince;
+
+	void resize(unsigned int newWidth, unsigned int newHeight);
+	void reserve(unsigned int pixelCount);
+	void release();
+	void setPhase(unsigned int newPhaseX, unsigned int newPhaseY);
+	void fill(sf::Color color);
+	void copyFrom(const Frame& other);
+	void copyFrom(const Frame& other, const sf::IntRect& rect);		// Same size and phase as other
+	void scroll(int offsetX, int offsetY);
+	void copyRegion(const sf::IntRect& rect, sf::Uint8* out) const;
+
+	// Pixel (x, y) is at rowOffset(y) + columnOffset(x), the next FRAME_TILE_SIZE - (x + phaseX) % FRAME_TILE_SIZE pixels of the row follow it
+	unsigned int rowOffset(unsigned int y) const
+	{
+		return (y + phaseY) / FRAME_TILE_SIZE * tilesX * FRAME_TILE_SIZE * FRAME_TILE_SIZE + (y + phaseY) % FRAME_TILE_SIZE * FRAME_TILE_SIZE;
+	}
+
+	unsigned int columnOffset(unsigned int x) const
+	{
+		return (x + phaseX) / FRAME_TILE_SIZE * FRAME_TILE_SIZE * FRAME_TILE_SIZE + (x + phaseX) % FRAME_TILE_SIZE;
+	}
+
+	sf::Color* pixelAt(unsigned int x, unsigned int y)
+	{
+		return reinterpret_cast<sf::Color*>(pixels) + rowOffset(y) + columnOffset(x);
+	}
+
+	const sf::Color* pixelAt(unsigned int x, unsigned int y) const
+	{
+		return reinterpret_cast<const sf::Color*>(pixels) + rowOffset(y) + columnOffset(x);
+	}
+};
+
+class FrameBuffer
+{
+	public:
+		FrameBuffer();
+		~FrameBuffer();
+
+		// Compute thread
+		Frame& back();
+		void markDirty(const sf::IntRect& rect);
+		void markAllDirty();
+		void publish();
+
+		// Window thread
+		bool isFresh() const;
+		bool acquire();
+		const Frame& front() const;
+		bool takeDirtyRegions(std::vector<sf::IntRect>& regions);
+
+	private:
+		struct DirtyRegion
+		{
+			unsigned long long sequence;
+			sf::IntRect rect;
+		};
+
+		static const unsigned int FRESH_BIT = 4;
+		static const unsigned int INDEX_MASK = 3;
+
+		Frame m_frames[3];
+
+		std::atomic<unsigned int> m_pending;
+		unsigned int m_back;
+		unsigned int m_front;
+
+		std::vector<sf::IntRect> m_backDirty;
+		bool m_backAllDirty;
+		unsigned long long m_sequence;
+
+		// Rectangles published since the oldest frame the compute side may get back, to bring it up to date
+		std::vector<DirtyRegion> m_syncLog;
+		unsigned long long m_syncAllSequence;
+
+		// Shared, behind m_dirtyMutex
+		std::vector<DirtyRegion> m_dirtyLog;
+		unsigned long long m_allDirtySequence;
+		unsigned long long m_shownSequence;
+		std::mutex m_dirtyMutex;
+};
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "framePool.h"
+
+FramePool::FramePool()
+{
+	m_idleBytes = 0;
+	m_allocationCount = 0;
+}
+
+FramePool::~FramePool()
+{
+	for (unsigned int i(0); i < m_idle.size(); i++)
+		deallocate(m_idle[i].data);
+}
+
+FramePool& FramePool::global()
+{
+	static FramePool pool;
+
+	return pool;
+}
+
+sf::Uint8* FramePool::acquire(std::size_t bytes, std::size_t& capacity)
+{
+	bytes = roundSize(bytes);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		unsigned int best((unsigned int)m_idle.size());
+
+		for (unsigned int i(0); i < m_idle.size(); i++)
+		{
+			if (m_idle[i].capacity >= bytes && m_idle[i].capacity <= 2 * bytes && (best == m_idle.size() || m_idle[i].capacity < m_idle[best].capacity))
+				best = i;
+		}
+
+		if (best < m_idle.size())
+		{
+			Buffer buffer(m_idle[best]);
+
+			m_idle.erase(m_idle.begin() + best);
+			m_idleBytes -= buffer.capacity;
+
+			capacity = buffer.capacity;
+			return buffer.data;
+		}
+
+		m_allocationCount++;
+	}
+
+	capacity = bytes;
+
+	return allocate(bytes);
+}
+
+void FramePool::release(sf::Uint8* buffer, std::size_t capacity)
+{
+	if (buffer == nullptr)
+		return;
+
+	std::vector<Buffer> freed;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_idle.push_back({ buffer, capacity });
+		m_idleBytes += capacity;
+
+		// Over budget: the largest buffers go first, they are the least likely to fit the next request
+		while (m_idleBytes > FRAME_POOL_IDLE_BUDGET)
+		{
+			std::vector<Buffer>::iterator largest(std::max_element(m_idle.begin(), m_idle.end(), [](const Buffer& a, const Buffer& b)
+			{
+				return a.capacity < b.capacity;
+			}));
+
+			freed.push_back(*largest);
+			m_idleBytes -= largest->capacity;
+			m_idle.erase(largest);
+		}
+	}
+
+	for (unsigned int i(0); i < freed.size(); i++)
+		deallocate(freed[i].data);
+}
+
+std::size_t FramePool::getIdleBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_idleBytes;
+}
+
+unsigned long long FramePool::getAllocationCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_allocationCount;
+}
+
+// PRIVATE
+sf::Uint8* FramePool::allocate(std::size_t bytes)
+{
+	std::size_t alignment(FRAME_POOL_ALIGNMENT);
+
+	if (FRAME_POOL_HUGE_PAGES && bytes >= FRAME_POOL_HUGE_PAGE_SIZE)
+		alignment = FRAME_POOL_HUGE_PAGE_SIZE;
+
+#if defined(_WIN32)
+	sf::Uint8* buffer(static_cast<sf::Uint8*>(_aligned_malloc(bytes, alignment)));
+#else
+	sf::Uint8* buffer(static_cast<sf::Uint8*>(std::aligned_alloc(alignment, bytes)));
+#endif
+
+	if (buffer == nullptr)
+		throw std::bad_alloc();
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (alignment == FRAME_POOL_HUGE_PAGE_SIZE)
+		madvise(buffer, bytes, MADV_HUGEPAGE);
+#endif
+
+	return buffer;
+}
+
+void FramePool::deallocate(sf::Uint8* buffer)
+{
+#if defined(_WIN32)
+	_aligned_free(buffer);
+#else
+	std::free(buffer);
+#endif
+}
+
+std::size_t FramePool::roundSize(std::size_t bytes)
+{
+	std::size_t granularity(FRAME_POOL_PAGE_SIZE);
+
+	if (FRAME_POOL_HUGE_PAGES && bytes >= FRAME_POOL_HUGE_PAGE_SIZE)
+		granularity = FRAME_POOL_HUGE_PAGE_SIZE;
+
+	return std::max((bytes + granularity - 1) / granularity * granularity, granularity);
+}
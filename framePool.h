@@ -0,0 +1,58 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Buffer start alignment, a cache line and the widest SIMD store
+#define FRAME_POOL_ALIGNMENT 64
+
+// Sizes are rounded up to whole pages
+#define FRAME_POOL_PAGE_SIZE 4096
+
+// Released buffers kept for reuse, past this many idle bytes the largest ones are freed
+#define FRAME_POOL_IDLE_BUDGET (256 * 1024 * 1024)
+
+// Buffers of at least a huge page are aligned on one and handed to transparent huge pages (Linux only)
+#define FRAME_POOL_HUGE_PAGES false
+#define FRAME_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/*
+- Pixel storage for the frames, shared by the whole program
+- release() keeps the buffer for the next acquire() instead of freeing it, so frames changing hands or sizes stop allocating
+- acquire() takes the smallest idle buffer big enough, unless it is more than twice the size asked for
+- How much to ask for (growth, shrinking) is up to the frame, see Frame::resize()
+*/
+
+class FramePool
+{
+	public:
+		FramePool();
+		~FramePool();
+
+		static FramePool& global();
+
+		sf::Uint8* acquire(std::size_t bytes, std::size_t& capacity);
+		void release(sf::Uint8* buffer, std::size_t capacity);
+
+		std::size_t getIdleBytes() const;
+		unsigned long long getAllocationCount() const;
+
+	private:
+		struct Buffer
+		{
+			sf::Uint8* data;
+			std::size_t capacity;
+		};
+
+		static sf::Uint8* allocate(std::size_t bytes);
+		static void deallocate(sf::Uint8* buffer);
+		static std::size_t roundSize(std::size_t bytes);
+
+		std::vector<Buffer> m_idle;
+		std::size_t m_idleBytes;
+		unsigned long long m_allocationCount;
+
+		mutable std::mutex m_mutex;
+};
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cctype>
+
+#include "imageWriter.h"
+
+// Largest payload of an uncompressed deflate block
+#define DEFLATE_STORED_MAX 65535
+
+ImageWriter::ImageWriter()
+{
+    m_format = ImageFormat::PPM;
+    m_width = 0;
+    m_height = 0;
+    m_rowsWritten = 0;
+    m_adler = 1;
+}
+
+ImageWriter::~ImageWriter()
+{
+    if (m_file.is_open())
+        close();
+}
+
+bool ImageWriter::open(const std::string& path, unsigned int width, unsigned int height)
+{
+    std::string extension(path.size() >= 4 ? path.substr(path.size() - 4) : "");
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+    if (extension == ".png")
+        m_format = ImageFormat::PNG;
+    else if (extension == ".ppm")
+        m_format = ImageFormat::PPM;
+    else
+        return false;
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+
+    if (!m_file)
+        return false;
+
+    m_width = width;
+    m_height = height;
+    m_rowsWritten = 0;
+    m_adler = 1;
+    m_block.clear();
+
+    if (m_format == ImageFormat::PPM)
+    {
+        m_file << "P6\n" << width << " " << height << "\n255\n";
+    }
+    else
+    {
+        static const sf::Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        m_file.write(reinterpret_cast<const char*>(signature), 8);
+
+        // 8 bits RGB, no interlacing
+        std::vector<sf::Uint8> header;
+        writeBigEndian(header, width);
+        writeBigEndian(header, height);
+        header.insert(header.end(), { 8, 2, 0, 0, 0 });
+        writeChunk("IHDR", header);
+
+        // zlib stream header: deflate, 32k window, no dictionary
+        m_chunk.assign({ 0x78, 0x01 });
+    }
+
+    return (bool)m_file;
+}
+
+bool ImageWriter::writeRows(const sf::Uint8* pixels, unsigned int rowCount)
+{
+    rowCount = std::min(rowCount, m_height - m_rowsWritten);
+
+    // PNG rows start with their filter type (none)
+    unsigned int offset(m_format == ImageFormat::PNG ? 1 : 0);
+    m_row.resize(offset + m_width * 3);
+
+    if (offset)
+        m_row[0] = 0;
+
+    for (unsigned int y(0); y < rowCount; y++)
+    {
+        const sf::Uint8* source(pixels + (std::size_t)y * m_width * 4);
+
+        for (unsigned int x(0); x < m_width; x++)
+        {
+            m_row[offset + x * 3] = source[x * 4];
+            m_row[offset + x * 3 + 1] = source[x * 4 + 1];
+            m_row[offset + x * 3 + 2] = source[x * 4 + 2];
+        }
+
+        if (m_format == ImageFormat::PPM)
+            m_file.write(reinterpret_cast<const char*>(m_row.data()), (std::streamsize)m_row.size());
+        else
+            deflateStored(m_row.data(), m_row.size(), m_chunk);
+    }
+
+    // One IDAT chunk per call, the stream is only closed by close()
+    if (m_format == ImageFormat::PNG && !m_chunk.empty())
+    {
+        writeChunk("IDAT", m_chunk);
+        m_chunk.clear();
+    }
+
+    m_rowsWritten += rowCount;
+
+    return (bool)m_file;
+}
+
+bool ImageWriter::close()
+{
+    if (!m_file.is_open())
+        return false;
+
+    bool complete(m_rowsWritten == m_height);
+
+    if (m_format == ImageFormat::PNG)
+    {
+        flushBlock(true, m_chunk);
+        writeBigEndian(m_chunk, m_adler);
+        writeChunk("IDAT", m_chunk);
+        m_chunk.clear();
+
+        writeChunk("IEND", m_chunk);
+    }
+
+    bool written((bool)m_file);
+    m_file.close();
+
+    return complete && written;
+}
+
+// PRIVATE
+void ImageWriter::writeChunk(const char* type, const std::vector<sf::Uint8>& data)
+{
+    std::vector<sf::Uint8> header;
+    writeBigEndian(header, (sf::Uint32)data.size());
+    header.insert(header.end(), type, type + 4);
+
+    sf::Uint32 crc(crc32(0xFFFFFFFFu, header.data() + 4, 4));
+    crc = crc32(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+    std::vector<sf::Uint8> footer;
+    writeBigEndian(footer, crc);
+
+    m_file.write(reinterpret_cast<const char*>(header.data()), (std::streamsize)header.size());
+    m_file.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    m_file.write(reinterpret_cast<const char*>(footer.data()), (std::streamsize)footer.size());
+}
+
+void ImageWriter::deflateStored(const sf::Uint8* data, std::size_t size, std::vector<sf::Uint8>& out)
+{
+    // Adler-32 of the uncompressed stream, the sums are reduced before they can overflow
+    sf::Uint32 a(m_adler & 0xFFFF), b(m_adler >> 16);
+
+    for (std::size_t first(0); first < size; first += 5552)
+    {
+        std::size_t last(std::min(first + 5552, size));
+
+        for (std::size_t i(first); i < last; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+    }
+
+    m_adler = (b << 16) | a;
+
+    while (size > 0)
+    {
+        std::size_t count(std::min(size, (std::size_t)DEFLATE_STORED_MAX - m_block.size()));
+
+        m_block.insert(m_block.end(), data, data + count);
+        data += count;
+        size -= count;
+
+        if (m_block.size() == DEFLATE_STORED_MAX)
+            flushBlock(false, out);
+    }
+}
+
+void ImageWriter::flushBlock(bool last, std::vector<sf::Uint8>& out)
+{
+    sf::Uint16 length((sf::Uint16)m_block.size());
+
+    out.push_back(last ? 1 : 0);
+    out.push_back((sf::Uint8)(length & 0xFF));
+    out.push_back((sf::Uint8)(length >> 8));
+    out.push_back((sf::Uint8)(~length & 0xFF));
+    out.push_back((sf::Uint8)((sf::Uint16)~length >> 8));
+    out.insert(out.end(), m_block.begin(), m_block.end());
+
+    m_block.clear();
+}
+
+void ImageWriter::writeBigEndian(std::vector<sf::Uint8>& out, sf::Uint32 value)
+{
+    out.push_back((sf::Uint8)(value >> 24));
+    out.push_back((sf::Uint8)(value >> 16));
+    out.push_back((sf::Uint8)(value >> 8));
+    out.push_back((sf::Uint8)value);
+}
+
+sf::Uint32 ImageWriter::crc32(sf::Uint32 crc, const sf::Uint8* data, std::size_t size)
+{
+    // Built once, the first call may come from any thread
+    static const std::vector<sf::Uint32> table([]
+    {
+        std::vector<sf::Uint32> entries(256);
+
+        for (sf::Uint32 n(0); n < 256; n++)
+        {
+            sf::Uint32 c(n);
+            for (unsigned int k(0); k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+            entries[n] = c;
+        }
+
+        return entries;
+    }());
+
+    for (std::size_t i(0); i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+- Writes an image a few rows at a time, so it never has to be held in memory as a whole
+- The format comes from the extension: binary PPM (.ppm), or PNG (.png) made of uncompressed deflate blocks
+- Rows are given as RGBA (the frame layout), the alpha channel is dropped
+*/
+
+enum class ImageFormat { PPM = 0, PNG };
+
+class ImageWriter
+{
+	public:
+		ImageWriter();
+		~ImageWriter();
+
+		bool open(const std::string& path, unsigned int width, unsigned int height);
+		bool writeRows(const sf::Uint8* pixels, unsigned int rowCount);
+		bool close();
+
+	private:
+		void writeChunk(const char* type, const std::vector<sf::Uint8>& data);
+		void deflateStored(const sf::Uint8* data, std::size_t size, std::vector<sf::Uint8>& out);
+		void flushBlock(bool last, std::vector<sf::Uint8>& out);
+
+		static void writeBigEndian(std::vector<sf::Uint8>& out, sf::Uint32 value);
+		static sf::Uint32 crc32(sf::Uint32 crc, const sf::Uint8* data, std::size_t size);
+
+		std::ofstream m_file;
+		ImageFormat m_format;
+		unsigned int m_width;
+		unsigned int m_height;
+		unsigned int m_rowsWritten;
+
+		std::vector<sf::Uint8> m_row;
+		std::vector<sf::Uint8> m_block;		// Deflate block being filled, at most 65535 bytes
+		std::vector<sf::Uint8> m_chunk;
+		sf::Uint32 m_adler;
+};
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "kernels.h"
+
+// Raw bytes of a value, to an identity compared within the same program
+template <class T>
+static void appendIdentity(std::string& identity, const T& value)
+{
+	identity.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string SolidKernel::identity() const
+{
+	std::string identity;
+	appendIdentity(identity, color.r);
+	appendIdentity(identity, color.g);
+	appendIdentity(identity, color.b);
+	appendIdentity(identity, color.a);
+
+	return identity;
+}
+
+void SolidKernel::row(const PixelRow& row, Output* out) const
+{
+	for (unsigned int i(0); i < row.count; i++)
+		out[i] = color;
+}
+
+#ifdef SIMD_X86
+SIMD_TARGET("sse2") void SolidKernel::rowSse2(const PixelRow& row, Output* out) const
+{
+	__m128i lanes = _mm_set1_epi32((int)Simd::pack(color));
+
+	unsigned int i(0);
+	for (; i + 4 <= row.count; i += 4)
+		_mm_storeu_si128((__m128i*)(out + i), lanes);
+
+	for (; i < row.count; i++)
+		out[i] = color;
+}
+
+SIMD_TARGET("avx2") void SolidKernel::rowAvx2(const PixelRow& row, Output* out) const
+{
+	__m256i lanes = _mm256_set1_epi32((int)Simd::pack(color));
+
+	unsigned int i(0);
+	for (; i + 8 <= row.count; i += 8)
+		_mm256_storeu_si256((__m256i*)(out + i), lanes);
+
+	for (; i < row.count; i++)
+		out[i] = color;
+}
+
+SIMD_TARGET("avx512f") void SolidKernel::rowAvx512(const PixelRow& row, Output* out) const
+{
+	__m512i lanes = _mm512_set1_epi32((int)Simd::pack(color));
+
+	unsigned int i(0);
+	for (; i + 16 <= row.count; i += 16)
+		_mm512_storeu_si512((void*)(out + i), lanes);
+
+	// Masked store for the tail, no scalar loop needed
+	if (i < row.count)
+		_mm512_mask_storeu_epi32((void*)(out + i), (__mmask16)((1u << (row.count - i)) - 1), lanes);
+}
+#endif
+
+// Dark blue at 0, through orange, to pale yellow at 1
+static sf::Color heatColor(float t)
+{
+	const float stops[3][3] = { { 20.f, 40.f, 120.f }, { 230.f, 120.f, 30.f }, { 255.f, 250.f, 200.f } };
+
+	unsigned int segment(t < 0.5f ? 0 : 1);
+	float f(t < 0.5f ? t * 2.f : t * 2.f - 1.f);
+
+	return sf::Color((sf::Uint8)(stops[segment][0] + (stops[segment + 1][0] - stops[segment][0]) * f),
+		(sf::Uint8)(stops[segment][1] + (stops[segment + 1][1] - stops[segment][1]) * f),
+		(sf::Uint8)(stops[segment][2] + (stops[segment + 1][2] - stops[segment][2]) * f));
+}
+
+void DensityKernel::block(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const
+{
+	// One bin per pixel of the block, per worker
+	static thread_local std::vector<float> bins;
+
+	bins.assign((std::size_t)width * height, 0.f);
+
+	float xMin(origin.x0), xMax(origin.x0 + (float)width * origin.dx);
+	float yMin(origin.y0), yMax(origin.y0 + (float)height * origin.dy);
+	float invDx(1.f / origin.dx), invDy(1.f / origin.dy);
+
+	Bounds bounds(dataset != nullptr ? dataset->getBounds() : Bounds{ 0.f, 1.f, 0.f, 1.f });
+	bool visible(dataset != nullptr && dataset->getPointCount() > 0
+		&& xMax >= bounds.xMin && xMin <= bounds.xMax && yMax >= bounds.yMin && yMin <= bounds.yMax);
+
+	if (visible)
+	{
+		unsigned int cellLeft(dataset->cellX(xMin)), cellRight(dataset->cellX(xMax));
+		unsigned int cellTop(dataset->cellY(yMin)), cellBottom(dataset->cellY(yMax));
+
+		if (origin.dx >= dataset->getCellWidth() && origin.dy >= dataset->getCellHeight())
+		{
+			// Cells no larger than a pixel: their counts are enough, however many points are behind them
+			// A cell straddles up to 2x2 pixels and is shared by area, whole cells per pixel would show the grid as a moire
+			float cellWidth(dataset->getCellWidth() * invDx), cellHeight(dataset->getCellHeight() * invDy);
+
+			for (unsigned int cellY(cellTop); cellY <= cellBottom; cellY++)
+			{
+				float top((bounds.yMin - yMin) * invDy + (float)cellY * cellHeight);
+				int firstY((int)std::floor(top));
+				float shareY(cellHeight > 0.f ? std::min(((float)firstY + 1.f - top) / cellHeight, 1.f) : 1.f);
+
+				for (unsigned int cellX(cellLeft); cellX <= cellRight; cellX++)
+				{
+					float count((float)dataset->cellCount(cellX, cellY));
+
+					if (count == 0.f)
+						continue;
+
+					float left((bounds.xMin - xMin) * invDx + (float)cellX * cellWidth);
+					int firstX((int)std::floor(left));
+					float shareX(cellWidth > 0.f ? std::min(((float)firstX + 1.f - left) / cellWidth, 1.f) : 1.f);
+
+					for (int y(firstY); y <= firstY + 1; y++)
+					{
+						float rowCount(count * (y == firstY ? shareY : 1.f - shareY));
+
+						if (y < 0 || y >= (int)height || rowCount <= 0.f)
+							continue;
+
+						for (int x(firstX); x <= firstX + 1; x++)
+						{
+							float share(x == firstX ? shareX : 1.f - shareX);
+
+							if (x >= 0 && x < (int)width && share > 0.f)
+								bins[(std::size_t)y * width + x] += rowCount * share;
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			// The cells of a row are contiguous in the index: one span of the mapped file per row of cells
+			for (unsigned int cellY(cellTop); cellY <= cellBottom; cellY++)
+			{
+				const PointRecord* end(dataset->cellsEnd(cellLeft, cellY, cellRight - cellLeft + 1));
+
+				for (const PointRecord* point(dataset->cellsBegin(cellLeft, cellY)); point != end; point++)
+				{
+					float x((point->x - xMin) * invDx);
+					float y((point->y - yMin) * invDy);
+
+					if (x >= 0.f && x < (float)width && y >= 0.f && y < (float)height)
+						bins[(std::size_t)y * width + (unsigned int)x] += 1.f;
+				}
+			}
+		}
+	}
+
+	// Density relative to the dataset mean, the same at any zoom, on a log scale so sparse and dense areas both read
+	float area((bounds.xMax - bounds.xMin) * (bounds.yMax - bounds.yMin));
+	float expected(visible && area > 0.f ? (float)dataset->getPointCount() * origin.dx * origin.dy / area : 1.f);
+	float scale(1.f / expected);
+	float normalization(1.f / log1pf(saturation));
+
+	for (unsigned int y(0); y < height; y++)
+	{
+		const float* row(bins.data() + (std::size_t)y * width);
+		sf::Color* out(pixels + (std::size_t)y * stride);
+
+		for (unsigned int x(0); x < width; x++)
+			out[x] = row[x] <= 0.f ? BACKGROUND_COLOR : heatColor(std::min(log1pf(row[x] * scale) * normalization, 1.f));
+	}
+}
+
+// The dataset's count and bounds, reading its points would make every worker read the whole index
+std::string DensityKernel::identity() const
+{
+	std::string identity;
+	appendIdentity(identity, saturation);
+
+	if (dataset != nullptr)
+	{
+		appendIdentity(identity, dataset->getPointCount());
+		appendIdentity(identity, dataset->getBounds());
+		appendIdentity(identity, dataset->getGridSize());
+	}
+
+	return identity;
+}
+
+void RasterKernel::block(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const
+{
+	if (raster == nullptr || raster->getLevelCount() == 0)
+	{
+		for (unsigned int y(0); y < height; y++)
+			std::fill(pixels + (std::size_t)y * stride, pixels + (std::size_t)y * stride + width, BACKGROUND_COLOR);
+
+		return;
+	}
+
+	// The level whose texels are the closest to a pixel, the same for every tile of a frame
+	float ratio(origin.dx / raster->getTexelWidth());
+	unsigned int level(ratio > 1.f ? (unsigned int)std::min(std::floor(std::log2(ratio) + 0.5f), (float)(raster->getLevelCount() - 1)) : 0u);
+
+	const RasterPyramid::Level& info(raster->getLevel(level));
+	const Bounds& bounds(raster->getBounds());
+	float texelWidth(std::ldexp(raster->getTexelWidth(), (int)level));
+	float texelHeight(std::ldexp(raster->getTexelHeight(), (int)level));
+
+	// Texel column of each pixel column, sampled at the pixel centers, -1 outside the raster
+	static thread_local std::vector<long long> columns;
+	columns.resize(width);
+
+	for (unsigned int x(0); x < width; x++)
+	{
+		float texel((origin.x0 + ((float)x + 0.5f) * origin.dx - bounds.xMin) / texelWidth);
+
+		columns[x] = texel >= 0.f && texel < (float)info.width ? (long long)texel : -1;
+	}
+
+	float valueMin(raster->getValueMin());
+	float valueScale(raster->getValueMax() > valueMin ? 1.f / (raster->getValueMax() - valueMin) : 0.f);
+
+	for (unsigned int y(0); y < height; y++)
+	{
+		sf::Color* out(pixels + (std::size_t)y * stride);
+		float texelY((origin.y0 + ((float)y + 0.5f) * origin.dy - bounds.yMin) / texelHeight);
+
+		if (texelY < 0.f || texelY >= (float)info.height)
+		{
+			std::fill(out, out + width, BACKGROUND_COLOR);
+			continue;
+		}
+
+		std::uint64_t row((std::uint64_t)texelY);
+		std::uint32_t tileY((std::uint32_t)(row / RASTER_TILE_SIZE));
+		unsigned int inTileY((unsigned int)(row % RASTER_TILE_SIZE));
+
+		for (unsigned int x(0); x < width; x++)
+		{
+			if (columns[x] < 0)
+			{
+				out[x] = BACKGROUND_COLOR;
+				continue;
+			}
+
+			std::uint64_t column((std::uint64_t)columns[x]);
+			float value(raster->tile(level, (std::uint32_t)(column / RASTER_TILE_SIZE), tileY)[inTileY * RASTER_TILE_SIZE + column % RASTER_TILE_SIZE]);
+
+			out[x] = std::isfinite(value) ? heatColor(std::min(std::max((value - valueMin) * valueScale, 0.f), 1.f)) : BACKGROUND_COLOR;
+		}
+	}
+}
+
+// The pyramid's size, bounds and value range, along with the texels of its coarsest level (a tile or a few)
+std::string RasterKernel::identity() const
+{
+	std::string identity;
+
+	if (raster == nullptr || raster->getLevelCount() == 0)
+		return identity;
+
+	const RasterPyramid::Level& top(raster->getLevel(raster->getLevelCount() - 1));
+
+	appendIdentity(identity, raster->getLevelCount());
+	appendIdentity(identity, raster->getLevel(0).width);
+	appendIdentity(identity, raster->getLevel(0).height);
+	appendIdentity(identity, raster->getBounds());
+	appendIdentity(identity, raster->getValueMin());
+	appendIdentity(identity, raster->getValueMax());
+
+	for (std::uint32_t tileY(0); tileY < top.tilesY; tileY++)
+	{
+		for (std::uint32_t tileX(0); tileX < top.tilesX; tileX++)
+			identity.append(reinterpret_cast<const char*>(raster->tile(raster->getLevelCount() - 1, tileX, tileY)), RASTER_TILE_SIZE * RASTER_TILE_SIZE * sizeof(float));
+	}
+
+	return identity;
+}
+
+void FormulaKernel::row(const PixelRow& row, Output* out) const
+{
+	if (formula == nullptr)
+		std::fill(out, out + row.count, std::nanf(""));
+	else
+		formula->evaluate(SimdLevel::SCALAR, row, out);
+}
+
+#ifdef SIMD_X86
+void FormulaKernel::rowAvx2(const PixelRow& row, Output* out) const
+{
+	if (formula == nullptr)
+		std::fill(out, out + row.count, std::nanf(""));
+	else
+		formula->evaluate(SimdLevel::AVX2, row, out);
+}
+
+void FormulaKernel::rowAvx512(const PixelRow& row, Output* out) const
+{
+	if (formula == nullptr)
+		std::fill(out, out + row.count, std::nanf(""));
+	else
+		formula->evaluate(SimdLevel::AVX512, row, out);
+}
+#endif
+
+sf::Color FormulaKernel::toColor(float value) const
+{
+	if (!std::isfinite(value))
+		return BACKGROUND_COLOR;
+
+	float scale(rangeMax != rangeMin ? 1.f / (rangeMax - rangeMin) : 1.f);
+
+	return heatColor(std::min(std::max((value - rangeMin) * scale, 0.f), 1.f));
+}
+
+std::string FormulaKernel::identity() const
+{
+	std::string identity;
+	appendIdentity(identity, rangeMin);
+	appendIdentity(identity, rangeMax);
+
+	if (formula != nullptr)
+		identity += formula->getSource();
+
+	return identity;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+#include "simd.h"
+#include "sharedData.h"
+#include "pointDataset.h"
+#include "rasterPyramid.h"
+#include "formula.h"
+
+// Point density shown at full color, relative to the mean density of the dataset
+#define DENSITY_SATURATION 64.f
+
+/*
+YOUR WORK HERE: write a kernel and plot it with Plot<YourKernel>
+
+A kernel is any copyable type with:
+- typedef Output: sf::Color, or any value type along with "sf::Color toColor(Output value) const"
+- either "Output operator()(float x, float y) const", evaluated per pixel and inlined in the tile loop
+- or "void row(const PixelRow& row, Output* out) const", evaluated per row
+  + optional rowSse2 / rowAvx2 / rowAvx512 with the same signature, compiled with SIMD_TARGET
+  + the widest one supported by the CPU is picked at runtime
+- or "void block(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const",
+  evaluated per tile (up to TILE_SIZE x TILE_SIZE), for kernels that need the whole block at once, such as binning points
+  + the full resolution is computed right away, without progressive levels nor adaptive sampling
+- optionally "std::string identity() const": what the output depends on besides the type (options, data source),
+  render farm workers are only accepted with the same identity as the coordinator (see renderFarm.h)
+*/
+
+// Solid fill, the default kernel
+struct SolidKernel
+{
+	typedef sf::Color Output;
+
+	SolidKernel(sf::Color fillColor = BACKGROUND_COLOR) : color(fillColor) {}
+
+	void row(const PixelRow& row, Output* out) const;
+#ifdef SIMD_X86
+	SIMD_TARGET("sse2") void rowSse2(const PixelRow& row, Output* out) const;
+	SIMD_TARGET("avx2") void rowAvx2(const PixelRow& row, Output* out) const;
+	SIMD_TARGET("avx512f") void rowAvx512(const PixelRow& row, Output* out) const;
+#endif
+
+	std::string identity() const;
+
+	sf::Color color;
+};
+
+// Escape time of the Mandelbrot set, smoothed, as an example of a scalar per-pixel kernel
+struct MandelbrotKernel
+{
+	typedef float Output;
+
+	MandelbrotKernel(unsigned int iterations = 256) : maxIterations(iterations) {}
+
+	float operator()(float x, float y) const
+	{
+		float zx(0.f), zy(0.f);
+		unsigned int i(0);
+
+		while (i < maxIterations && zx * zx + zy * zy <= 256.f)
+		{
+			float tmp(zx * zx - zy * zy + x);
+			zy = 2.f * zx * zy + y;
+			zx = tmp;
+			i++;
+		}
+
+		if (i == maxIterations)
+			return -1.f;
+
+		return ((float)i + 1.f - log2f(log2f(zx * zx + zy * zy) * 0.5f)) / (float)maxIterations;
+	}
+
+	sf::Color toColor(float value) const
+	{
+		if (value < 0.f)
+			return sf::Color::Black;
+
+		float t(sqrtf(value));
+
+		return sf::Color((sf::Uint8)(255.f * t), (sf::Uint8)(255.f * t * t), (sf::Uint8)(100.f + 155.f * t));
+	}
+
+	std::string identity() const { return std::to_string(maxIterations); }
+
+	unsigned int maxIterations;
+};
+
+// Points of a memory mapped dataset binned per pixel, as an example of a block kernel
+struct DensityKernel
+{
+	typedef sf::Color Output;
+
+	DensityKernel(const PointDataset* points = nullptr, float saturationRatio = DENSITY_SATURATION) : dataset(points), saturation(saturationRatio) {}
+
+	void block(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const;
+	std::string identity() const;
+
+	const PointDataset* dataset;		// Not owned, must outlive the plot
+	float saturation;
+};
+
+// Scalar raster read from a memory mapped pyramid, at the level matching the pixel size
+struct RasterKernel
+{
+	typedef sf::Color Output;
+
+	RasterKernel(const RasterPyramid* pyramid = nullptr) : raster(pyramid) {}
+
+	void block(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const;
+	std::string identity() const;
+
+	const RasterPyramid* raster;		// Not owned, must outlive the plot
+};
+
+// Formula compiled at runtime, its value mapped from [rangeMin, rangeMax] to a heat ramp, non finite values left blank
+struct FormulaKernel
+{
+	typedef float Output;
+
+	FormulaKernel(const Formula* compiled = nullptr, float low = 0.f, float high = 1.f) : formula(compiled), rangeMin(low), rangeMax(high) {}
+
+	// The formula picks its own instructions, the variants only tell it which ones the CPU has
+	void row(const PixelRow& row, Output* out) const;
+#ifdef SIMD_X86
+	void rowAvx2(const PixelRow& row, Output* out) const;
+	void rowAvx512(const PixelRow& row, Output* out) const;
+#endif
+
+	sf::Color toColor(float value) const;
+	std::string identity() const;
+
+	const Formula* formula;		// Not owned, must outlive the plot, swapping it needs a new frame
+	float rangeMin;
+	float rangeMax;
+};
@@ -1,31 +1,293 @@
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+
 #include "mainWindow.h"
 #include "plot.h"
 
+// Header declaring PLOT_KERNEL when it is not one of kernels.h, see add_plotter_executable() in CMakeLists.txt
+#ifdef PLOT_KERNEL_HEADER
+#include PLOT_KERNEL_HEADER
+#endif
+
 /*
--> To draw pixel by pixel, go to plot.cpp -> compute()
+-> To draw pixel by pixel, write a kernel (see kernels.h) and build it with add_plotter_executable(<target> YourKernel yourKernel.h [sources]) in CMake
 -> To draw SFML objects, go to mainWindow.cpp -> update();
+-> To render without a window: --render <file.ppm|file.png> <width> <height> <xMin> <xMax> <yMin> <yMax>
+-> To export a camera path as raw RGBA frames: --animate <path.txt> <file.rgba|-> <width> <height> <frames>
+-> To render on several processes or machines: --farm <port> <file.ppm|file.png> <width> <height> <xMin> <xMax> <yMin> <yMax>, then --worker <host> <port> for each worker
+-> To record a timeline: --trace <file.json>, dumped with F4 and on exit (open it in chrome://tracing or ui.perfetto.dev)
+-> To plot the density of a point dataset (flat x, y, value floats, see pointDataset.h): --points <file> first, then any other option
+-> To explore a raster pyramid (built with pyramidBuilder, see rasterPyramid.h): --raster <file.pyramid> first, then any other option
+-> To plot a formula (see formula.h), as text or from a file recompiled whenever it is saved: --formula <expression|file> first, then any other option
 */
 
-int main()
+// Room around a data source when the window opens on it
+#define DATA_VIEW_MARGIN 1.1f
+
+// A formula file is checked this often for changes, in seconds
+#define FORMULA_RELOAD_INTERVAL 0.25f
+
+#ifndef PLOT_KERNEL
+#define PLOT_KERNEL SolidKernel
+#endif
+
+// Options start at args[0], the program name is only for the usage message
+// reload, if any, is polled while the window is idle and returns true when it changed the kernel
+template <class Kernel>
+static int run(SharedData& data, Plot<Kernel>& plot, const char* program, int argCount, char* args[], sf::Vector2f cameraPosition, float zoom,
+    const std::function<bool()>& reload = nullptr)
 {
-    SharedData data;
+    // Headless: no window is ever created, so this runs on machines without a display
+    if (argCount > 0 && std::string(args[0]) == "--render")
+    {
+        if (argCount != 8)
+        {
+            std::cerr << "Usage: " << program << " [--points <file> | --raster <file.pyramid> | --formula <expression|file>] --render <file.ppm|file.png> <width> <height> <xMin> <xMax> <yMin> <yMax>" << std::endl;
+            return 1;
+        }
+
+        Bounds bounds = { strtof(args[4], nullptr), strtof(args[5], nullptr), strtof(args[6], nullptr), strtof(args[7], nullptr) };
+        unsigned int width((unsigned int)strtoul(args[2], nullptr, 10));
+        unsigned int height((unsigned int)strtoul(args[3], nullptr, 10));
+
+        if (!plot.render(args[1], bounds, width, height))
+        {
+            std::cerr << "Could not render to " << args[1] << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    // Raw RGBA frames, for an encoder: ffmpeg -f rawvideo -pix_fmt rgba -s <width>x<height> -r 30 -i <file|-> out.mp4
+    if (argCount > 0 && std::string(args[0]) == "--animate")
+    {
+        if (argCount != 6)
+        {
+            std::cerr << "Usage: " << program << " [--points <file> | --raster <file.pyramid> | --formula <expression|file>] --animate <path.txt> <file.rgba|-> <width> <height> <frames>" << std::endl;
+            return 1;
+        }
+
+        CameraPath camera;
+
+        if (!camera.load(args[1]))
+        {
+            std::cerr << "Could not read a camera path from " << args[1] << " (one \"xMin xMax yMin yMax\" keyframe per line)" << std::endl;
+            return 1;
+        }
+
+        unsigned int width((unsigned int)strtoul(args[3], nullptr, 10));
+        unsigned int height((unsigned int)strtoul(args[4], nullptr, 10));
+        unsigned int frameCount((unsigned int)strtoul(args[5], nullptr, 10));
+
+        if (!plot.renderAnimation(args[2], camera, width, height, frameCount))
+        {
+            std::cerr << "Could not export the animation to " << args[2] << std::endl;
+            return 1;
+        }
 
-    Plot plot(&data);
-    Display::MainWindow* win = new Display::MainWindow(&data);
+        return 0;
+    }
 
-    while (win->isOpen())
+    // Offline render split over worker processes: the coordinator only hands out tiles and writes the image
+    if (argCount > 0 && std::string(args[0]) == "--farm")
     {
-        if (data.eventType == Event::CAMERA_MOVED)
+        if (argCount != 9)
         {
-            plot.compute();
+            std::cerr << "Usage: " << program << " [--points <file> | --raster <file.pyramid> | --formula <expression|file>] --farm <port> <file.ppm|file.png> <width> <height> <xMin> <xMax> <yMin> <yMax>" << std::endl;
+            return 1;
         }
-        else if (data.eventType == Event::WINDOW_RESIZED)
+
+        Bounds bounds = { strtof(args[5], nullptr), strtof(args[6], nullptr), strtof(args[7], nullptr), strtof(args[8], nullptr) };
+        unsigned int width((unsigned int)strtoul(args[3], nullptr, 10));
+        unsigned int height((unsigned int)strtoul(args[4], nullptr, 10));
+
+        RenderCoordinator coordinator;
+
+        return coordinator.run((unsigned short)strtoul(args[1], nullptr, 10), args[2], bounds, width, height, plot.getFarmIdentity()) ? 0 : 1;
+    }
+
+    // Started with the same data source and kernel options as the coordinator, on any host that reaches it
+    if (argCount > 0 && std::string(args[0]) == "--worker")
+    {
+        if (argCount != 3)
         {
-            plot.updatePlotSettings();
+            std::cerr << "Usage: " << program << " [--points <file> | --raster <file.pyramid> | --formula <expression|file>] --worker <host> <port>" << std::endl;
+            return 1;
         }
+
+        return plot.renderWorker(args[1], (unsigned short)strtoul(args[2], nullptr, 10)) ? 0 : 1;
+    }
+
+    if (argCount > 1 && std::string(args[0]) == "--trace")
+    {
+        data.trace.setOutput(args[1]);
+        data.trace.nameThread("compute");
+    }
+
+    Display::MainWindow* win = new Display::MainWindow(&data, cameraPosition, zoom);
+
+    // Sleeps until the window submits a camera newer than the one rendered (or the kernel changes), returns once the window is closed
+    while (reload ? data.camera.wait(plot.getGeneration(), FORMULA_RELOAD_INTERVAL) : data.camera.wait(plot.getGeneration()))
+    {
+        if (reload && reload())
+            plot.invalidate();
+        else if (data.camera.getGeneration() == plot.getGeneration())
+            continue;
+
+        plot.compute();
     }
 
     delete win;
 
+    if (data.trace.isEnabled() && !data.trace.dump())
+    {
+        std::cerr << "Could not write the trace to " << data.trace.getOutput() << std::endl;
+        return 1;
+    }
+
     return 0;
 }
+
+// Camera showing the whole of a data source
+static void frameBounds(const Bounds& bounds, sf::Vector2f& center, float& zoom)
+{
+    center = sf::Vector2f((bounds.xMin + bounds.xMax) * 0.5f, (bounds.yMin + bounds.yMax) * 0.5f);
+    zoom = std::max((bounds.xMax - bounds.xMin) / DEFAULT_WIN_WIDTH, (bounds.yMax - bounds.yMin) / DEFAULT_WIN_HEIGHT) * DATA_VIEW_MARGIN;
+
+    if (zoom <= 0.f)
+        zoom = DEFAULT_ZOOM;
+}
+
+static bool readFile(const std::string& path, std::string& content)
+{
+    std::ifstream file(path);
+
+    if (!file)
+        return false;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    content = stream.str();
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    SharedData data;
+
+    sf::Vector2f center;
+    float zoom(DEFAULT_ZOOM);
+
+    // A data source takes the place of the kernel, the window starts on the whole of it
+    if (argc > 2 && std::string(argv[1]) == "--points")
+    {
+        PointDataset dataset;
+
+        // On stderr: stdout may be carrying the frames of --animate
+        std::clog << "Opening " << argv[2] << ", the first time builds its index" << std::endl;
+
+        if (!dataset.open(argv[2]))
+        {
+            std::cerr << "Could not open or index " << argv[2] << std::endl;
+            return 1;
+        }
+
+        frameBounds(dataset.getBounds(), center, zoom);
+
+        Plot<DensityKernel> plot(&data, DensityKernel(&dataset));
+
+        return run(data, plot, argv[0], argc - 3, argv + 3, center, zoom);
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--raster")
+    {
+        RasterPyramid raster;
+
+        if (!raster.open(argv[2]))
+        {
+            std::cerr << "Could not open the pyramid " << argv[2] << " (convert rasters with pyramidBuilder)" << std::endl;
+            return 1;
+        }
+
+        frameBounds(raster.getBounds(), center, zoom);
+
+        Plot<RasterKernel> plot(&data, RasterKernel(&raster));
+
+        return run(data, plot, argv[0], argc - 3, argv + 3, center, zoom);
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--formula")
+    {
+        std::string path(argv[2]), source(argv[2]);
+        std::error_code error;
+        bool isFile(std::filesystem::is_regular_file(path, error));
+        std::filesystem::file_time_type modified;
+
+        if (isFile)
+        {
+            modified = std::filesystem::last_write_time(path, error);
+
+            if (!readFile(path, source))
+            {
+                std::cerr << "Could not read " << path << std::endl;
+                return 1;
+            }
+        }
+
+        Formula formula;
+        std::string message;
+
+        if (!formula.compile(source, message))
+        {
+            std::cerr << (isFile ? path : std::string("Formula")) << ": " << message << std::endl;
+            return 1;
+        }
+
+        Plot<FormulaKernel> plot(&data, FormulaKernel(&formula));
+
+        // Called between frames, never while a frame is computed: the formula can be replaced in place
+        // A formula that does not compile leaves the previous one on screen
+        std::function<bool()> reload;
+
+        if (isFile)
+        {
+            reload = [&path, &formula, &modified]()
+            {
+                std::error_code error;
+                std::filesystem::file_time_type time(std::filesystem::last_write_time(path, error));
+                std::string source, message;
+
+                if (error || time == modified || !readFile(path, source))
+                    return false;
+
+                modified = time;
+
+                if (source == formula.getSource())
+                    return false;
+
+                if (!formula.compile(source, message))
+                {
+                    std::cerr << path << ": " << message << std::endl;
+                    return false;
+                }
+
+                std::cout << "Reloaded " << path << " (" << formula.getInstructionCount() << " instructions)" << std::endl;
+                return true;
+            };
+        }
+
+        return run(data, plot, argv[0], argc - 3, argv + 3, DEFAULT_CAMERA_POSITION, DEFAULT_ZOOM, reload);
+    }
+
+    Plot<PLOT_KERNEL> plot(&data);
+
+    return run(data, plot, argv[0], argc - 1, argv + 1, DEFAULT_CAMERA_POSITION, DEFAULT_ZOOM);
+}
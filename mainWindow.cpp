@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
@@ -7,9 +8,11 @@
 
 using namespace Display;
 
-MainWindow::MainWindow(SharedData* data)
+MainWindow::MainWindow(SharedData* data, sf::Vector2f cameraPosition, float zoom)
 {
 	m_window = nullptr;
+	m_cameraPosition = cameraPosition;
+	m_zoom = zoom;
 	m_status.currentState = State::OPENED;
 	m_data = data;
 
@@ -47,54 +50,70 @@ bool MainWindow::isOpen()
 // PRIVATE
 void MainWindow::windowLoop()
 {
+	m_data->trace.nameThread("window");
+
 	m_staticView = new sf::View(sf::FloatRect(0.f, 0.f, DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT));
 
-	m_zoom = DEFAULT_ZOOM;
-	m_cameraPosition = DEFAULT_CAMERA_POSITION;
 	m_dynamicView = new sf::View(m_cameraPosition, sf::Vector2f(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT));
 	m_dynamicView->zoom(m_zoom);
 	getBounds();
 
 	m_window = new sf::RenderWindow(sf::VideoMode(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT), "SFML Plot");
 
+	m_window->setVerticalSyncEnabled(WINDOW_VSYNC);
+
 	m_showDebug = true;
+	m_data->stats.setEnabled(m_showDebug);
+	m_renderScale = 1;
 
-	m_data->eventType = Event::CAMERA_MOVED;
+	m_cameraChanged = true;
+	m_redraw = true;
 	m_framerate = 0.f;
-	m_timePoint = m_chrono.getElapsedTime();
+	m_nextFrame = std::chrono::steady_clock::now();
 	while (m_window->isOpen())
 	{
-		if (timeForNextFrame())
-		{
-			checkCommands();
+		waitForNextFrame();
+
+		checkCommands();
 
-			handleEvents();
+		handleEvents();
 
+		updateCamera();
+
+		// Nothing moved and nothing new was computed: the last drawn frame is still on screen
+		if (m_window->isOpen() && (m_redraw || m_data->frameBuffer.isFresh() || (m_showDebug && m_data->stats.isReportDue())))
 			update();
-		}
 	}
+
+	// Wakes the compute thread up so it can see the window is gone
+	m_data->camera.close();
 }
 
-bool MainWindow::timeForNextFrame()
+void MainWindow::waitForNextFrame()
 {
-	int duration(m_chrono.getElapsedTime().asMilliseconds() - m_timePoint.asMilliseconds());
+	std::chrono::steady_clock::time_point now(std::chrono::steady_clock::now());
 
-	if (duration >= 1000.f / FPS_TARGET)
-	{
-		m_framerate = 1000.f / duration;
+	m_nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / FPS_TARGET));
 
-		m_timePoint = m_chrono.getElapsedTime();
-		return true;
+	// Behind schedule after a slow frame: start again from now rather than catching up with a burst
+	if (m_nextFrame <= now)
+	{
+		m_nextFrame = now;
+		return;
 	}
 
-	return false;
+	// Sleeps the whole time, the thread costs nothing between frames
+	std::this_thread::sleep_until(m_nextFrame);
 }
 
 void MainWindow::handleEvents()
 {
+	TraceSpan span(m_data->trace, "handleEvents");
 	sf::Event event;
 	while (m_window->pollEvent(event))
 	{
+		m_redraw = true;
+
 		if (event.type == sf::Event::Closed)
 		{
 			m_status.currentState = State::CLOSED;
@@ -105,6 +124,7 @@ void MainWindow::handleEvents()
 			if (event.key.code == sf::Keyboard::F3)
 			{
 				m_showDebug = !m_showDebug;
+				m_data->stats.setEnabled(m_showDebug);
 			}
 			else if (event.key.code == sf::Keyboard::Escape)
 			{
@@ -115,6 +135,10 @@ void MainWindow::handleEvents()
 			{
 				m_grid.show = !m_grid.show;
 			}
+			else if (event.key.code == sf::Keyboard::F4)
+			{
+				dumpTrace();
+			}
 		}
 		else if (event.type == sf::Event::MouseButtonPressed)
 		{
@@ -145,13 +169,17 @@ void MainWindow::handleEvents()
 				m_dynamicView->setCenter(m_cameraPosition);
 				m_window->setView(*m_dynamicView);
 
-				m_data->eventType = Event::CAMERA_MOVED;
+				m_cameraChanged = true;
+				m_camera.interacting = true;
+				m_interactionClock.restart();
 				m_lastMousePosition = currentMousePosition;
 			}
 		}
 		else if (event.type == sf::Event::MouseWheelScrolled)
 		{
-			m_data->eventType = Event::CAMERA_MOVED;
+			m_cameraChanged = true;
+			m_camera.interacting = true;
+			m_interactionClock.restart();
 
 			if (event.mouseWheelScroll.delta < 0)
 			{
@@ -170,21 +198,18 @@ void MainWindow::handleEvents()
 		}
 		else if (event.type == sf::Event::Resized)
 		{
-			m_data->eventType = Event::WINDOW_RESIZED;
+			m_cameraChanged = true;
 
-			m_data->mutex.lock();
-			m_data->windowWidth = event.size.width;
-			m_data->windowHeight = event.size.height;
-			resizePixelData();
-			m_data->mutex.unlock();
+			m_camera.windowWidth = event.size.width;
+			m_camera.windowHeight = event.size.height;
 
 			getBounds();
 
 			m_dynamicView->setCenter(m_cameraPosition);
-			m_dynamicView->setSize((float)m_data->windowWidth, (float)m_data->windowHeight);
+			m_dynamicView->setSize((float)m_camera.windowWidth, (float)m_camera.windowHeight);
 			m_dynamicView->zoom(m_zoom);
 
-			m_staticView->reset(sf::FloatRect(0.f, 0.f, (float)m_data->windowWidth, (float)m_data->windowHeight));
+			m_staticView->reset(sf::FloatRect(0.f, 0.f, (float)m_camera.windowWidth, (float)m_camera.windowHeight));
 		}
 	}
 }
@@ -204,12 +229,37 @@ void MainWindow::checkCommands()
 	m_status.mutex.unlock();
 }
 
+void MainWindow::updateCamera()
+{
+	// The camera stopped moving: ask for a full resolution frame
+	if (m_camera.interacting && m_interactionClock.getElapsedTime().asSeconds() >= INTERACTION_IDLE_DELAY)
+	{
+		m_camera.interacting = false;
+		m_cameraChanged = true;
+	}
+
+	if (m_cameraChanged)
+		submitCamera();
+}
+
 void MainWindow::update()
 {
+	bool measured(m_data->stats.isEnabled());
+	PerfStats::Clock::time_point frameStart;
+
+	if (measured)
+		frameStart = PerfStats::Clock::now();
+
+	m_framerate = 1.f / std::max(m_chrono.restart().asSeconds(), 1e-6f);
+	m_redraw = false;
+
 	m_window->clear();
 
 	// Pixel data is drawn in the referential of the window
-	updateScreenBuffer();
+	{
+		PerfTimer timer(m_data->stats, PerfStage::UPLOAD);
+		updateScreenBuffer();
+	}
 
 	// ========= ELEMENTS IN SFML REFERENTIAL =========
 	//m_window->setView(*m_dynamicView);
@@ -219,46 +269,105 @@ void MainWindow::update()
 
 	if (m_grid.show)
 	{
-		computeGrid();
-		createGridLabels();
+		PerfTimer timer(m_data->stats, PerfStage::GRID);
+		const Bounds& built(m_grid.bounds);
+		const Bounds& bounds(m_camera.bounds);
+
+		// The vertex arrays outlive the frame, they only change with the view
+		if (!m_grid.built || m_grid.windowSize != m_window->getSize() || built.xMin != bounds.xMin || built.xMax != bounds.xMax || built.yMin != bounds.yMin || built.yMax != bounds.yMax)
+		{
+			computeGrid(m_grid, m_camera.bounds, m_window->getSize());
+			createGridLabels(m_grid, *m_debugPanel.font);
+		}
+
 		drawGrid();
 	}
 
 	if (m_showDebug)
+	{
+		PerfTimer timer(m_data->stats, PerfStage::TEXT);
 		drawDebugInfo();
+	}
 
-	m_window->display();
+	{
+		TraceSpan span(m_data->trace, "display");
+		m_window->display();
+	}
+
+	if (measured)
+		m_data->stats.addFrame(PerfStats::Clock::now() - frameStart);
 }
 
 void MainWindow::updateScreenBuffer()
 {
+	TraceSpan span(m_data->trace, "updateScreenBuffer");
+
 	m_window->setView(*m_staticView);
 
-	m_data->mutex.lock();
-	m_screenImage.create(m_data->windowWidth, m_data->windowHeight, m_data->pixels);
-	m_data->mutex.unlock();
+	// Never blocks: the texture is only updated when the compute side has published a new frame
+	if (m_data->frameBuffer.acquire())
+	{
+		const Frame& frame = m_data->frameBuffer.front();
+		bool partial(m_data->frameBuffer.takeDirtyRegions(m_dirtyRegions));
+
+		if (m_screenTexture.getSize() != sf::Vector2u(frame.width, frame.height))
+		{
+			m_screenTexture.create(frame.width, frame.height);
+			m_screenSprite.setTexture(m_screenTexture, true);
+			partial = false;
+		}
 
-	m_screenTexture.loadFromImage(m_screenImage);
-	m_screenSprite.setTexture(m_screenTexture);
+		unsigned int dirtyArea(0);
+		for (unsigned int i(0); i < m_dirtyRegions.size(); i++)
+			dirtyArea += (unsigned int)(m_dirtyRegions[i].width * m_dirtyRegions[i].height);
+
+		// Overlapping rectangles covering more than the frame cost more than a single upload
+		if (partial && dirtyArea < frame.width * frame.height)
+		{
+			for (unsigned int i(0); i < m_dirtyRegions.size(); i++)
+				uploadRegion(frame, m_dirtyRegions[i]);
+		}
+		else
+		{
+			uploadRegion(frame, sf::IntRect(0, 0, (int)frame.width, (int)frame.height));
+		}
+
+		// Frames rendered at a lower resolution are stretched back to the window size, and the world pixel grid realigned to the bounds
+		m_screenSprite.setScale(frame.scale);
+		m_screenSprite.setPosition(frame.offset);
+		m_renderScale = (unsigned int)(frame.scale.x + 0.5f);
+	}
 
 	m_window->draw(m_screenSprite);
 }
 
-void MainWindow::computeGrid()
+void MainWindow::uploadRegion(const Frame& frame, const sf::IntRect& rect)
+{
+	unsigned int width((unsigned int)rect.width), height((unsigned int)rect.height);
+
+	// The frame is stored in tiles, the texture wants rows: only here are the pixels put back in row order
+	m_uploadBuffer.resize(width * height * 4);
+	frame.copyRegion(rect, m_uploadBuffer.data());
+
+	m_screenTexture.update(m_uploadBuffer.data(), width, height, (unsigned int)rect.left, (unsigned int)rect.top);
+}
+
+void MainWindow::computeGrid(Grid& grid, const Bounds& bounds, sf::Vector2u windowSize)
 {
 	float step;
-	float gridXMin(m_data->plotBounds.xMin), gridXMax(m_data->plotBounds.xMax);
-	float gridYMin(m_data->plotBounds.yMin), gridYMax(m_data->plotBounds.yMax);
+	float gridXMin(bounds.xMin), gridXMax(bounds.xMax);
+	float gridYMin(bounds.yMin), gridYMax(bounds.yMax);
+	float spanX(bounds.xMax - bounds.xMin), spanY(bounds.yMax - bounds.yMin);
 
 	Line line;
 
-	step = log10f(m_dynamicView->getSize().x);
+	step = log10f(spanX);
 	step = roundf(step);
 	step--;
 	step = pow(10.f, step);
 
-	m_grid.m_abscissLines.clear();
-	m_grid.m_ordinateLines.clear();
+	grid.m_abscissLines.clear();
+	grid.m_ordinateLines.clear();
 
 	if (step > 0.0001f)
 	{
@@ -301,7 +410,8 @@ void MainWindow::computeGrid()
 		for (float x(gridXMin); x <= gridXMax; x += step)
 		{
 			line.plotPos = x;
-			line.pos = m_window->mapCoordsToPixel(sf::Vector2f(line.plotPos, 0.f), *m_dynamicView).x;
+			// Same as mapping through the dynamic view, which spans the bounds over the whole window
+			line.pos = (int)((line.plotPos - bounds.xMin) / spanX * (float)windowSize.x);
 
 			if (fabs(x) <= 0.1f * step)
 				line.type = LineType::ABSOLUTE_MAIN;
@@ -310,13 +420,13 @@ void MainWindow::computeGrid()
 			else
 				line.type = LineType::NORMAL;
 
-			m_grid.m_ordinateLines.push_back(line);
+			grid.m_ordinateLines.push_back(line);
 		}
 
 		for (float y(gridYMin); y <= gridYMax; y += step)
 		{
 			line.plotPos = y;
-			line.pos = m_window->mapCoordsToPixel(sf::Vector2f(0.f, line.plotPos), *m_dynamicView).y;
+			line.pos = (int)((line.plotPos - bounds.yMin) / spanY * (float)windowSize.y);
 
 			if (fabs(y) <= 0.1f * step)
 				line.type = LineType::ABSOLUTE_MAIN;
@@ -325,112 +435,116 @@ void MainWindow::computeGrid()
 			else
 				line.type = LineType::NORMAL;
 
-			m_grid.m_abscissLines.push_back(line);
+			grid.m_abscissLines.push_back(line);
 		}
 	}
-}
 
-void MainWindow::createGridLabels()
-{
-	for (unsigned int i(0); i < m_grid.m_abscissLines.size(); i++)
+	sf::Color normalColor = { 90,  90,  90 };
+	sf::Color mainColor = { 150, 150, 150 };
+	float width((float)windowSize.x), height((float)windowSize.y);
+
+	// Lines are 1 pixel wide quads and the axes 2 pixels, so everything fits in a single triangle list
+	grid.lines.clear();
+
+	for (unsigned int i(0); i < grid.m_abscissLines.size(); i++)
 	{
-		m_grid.m_abscissLines[i].valueLabelTxt.setFont(*m_debugPanel.font);
-		m_grid.m_abscissLines[i].valueLabelTxt.setCharacterSize(DEBUG_FONT_SIZE);
-		m_grid.m_abscissLines[i].valueLabelTxt.setString(decimal2str(m_grid.m_abscissLines[i].plotPos, 3));
-		m_grid.m_abscissLines[i].valueLabelTxt.setPosition(0.f, (float)m_grid.m_abscissLines[i].pos);
+		const Line& abscissa(grid.m_abscissLines[i]);
+		float thickness(abscissa.type == LineType::ABSOLUTE_MAIN ? 2.f : 1.f);
+
+		appendQuad(grid.lines, sf::FloatRect(0.f, (float)abscissa.pos, width, thickness), abscissa.type == LineType::NORMAL ? normalColor : mainColor);
 	}
 
-	for (unsigned int i(0); i < m_grid.m_ordinateLines.size(); i++)
+	for (unsigned int i(0); i < grid.m_ordinateLines.size(); i++)
 	{
-		m_grid.m_ordinateLines[i].valueLabelTxt.setFont(*m_debugPanel.font);
-		m_grid.m_ordinateLines[i].valueLabelTxt.setCharacterSize(DEBUG_FONT_SIZE);
-		m_grid.m_ordinateLines[i].valueLabelTxt.setString(decimal2str(m_grid.m_ordinateLines[i].plotPos, 3));
-		m_grid.m_ordinateLines[i].valueLabelTxt.setPosition((float)m_grid.m_ordinateLines[i].pos, 0.f);
+		const Line& ordinate(grid.m_ordinateLines[i]);
+
+		if (ordinate.type == LineType::ABSOLUTE_MAIN)
+			appendQuad(grid.lines, sf::FloatRect((float)ordinate.pos - 2.f, 0.f, 2.f, height), mainColor);
+		else
+			appendQuad(grid.lines, sf::FloatRect((float)ordinate.pos, 0.f, 1.f, height), ordinate.type == LineType::NORMAL ? normalColor : mainColor);
 	}
+
+	grid.bounds = bounds;
+	grid.windowSize = windowSize;
+	grid.built = true;
 }
 
-void MainWindow::drawGrid()
+void MainWindow::createGridLabels(Grid& grid, const sf::Font& font)
 {
-	m_window->setView(*m_staticView);
+	grid.labels.clear();
 
-	sf::Color normalColor = { 90,  90,  90 };
-	sf::Color mainColor = { 150, 150, 150 };
+	if (grid.labelCache.size() > GRID_LABEL_CACHE_SIZE)
+		grid.labelCache.clear();
 
-	for (unsigned int i(0); i < m_grid.m_abscissLines.size(); i++)
-	{
-		float posY = (float)m_grid.m_abscissLines[i].pos;
+	for (unsigned int i(0); i < grid.m_abscissLines.size(); i++)
+		appendLabel(grid, font, decimal2str(grid.m_abscissLines[i].plotPos, 3), sf::Vector2f(0.f, (float)grid.m_abscissLines[i].pos));
 
-		if (m_grid.m_abscissLines[i].type == LineType::ABSOLUTE_MAIN)
-		{
-			sf::RectangleShape line(sf::Vector2f((float)m_data->windowWidth, 2));
+	for (unsigned int i(0); i < grid.m_ordinateLines.size(); i++)
+		appendLabel(grid, font, decimal2str(grid.m_ordinateLines[i].plotPos, 3), sf::Vector2f((float)grid.m_ordinateLines[i].pos, 0.f));
+}
 
-			line.setPosition(0, posY);
-			line.setFillColor(mainColor);
+void MainWindow::drawGrid()
+{
+	TraceSpan span(m_data->trace, "drawGrid");
 
-			m_window->draw(line);
-			m_window->draw(m_grid.m_abscissLines[i].valueLabelTxt);
-		}
-		else if (m_grid.m_abscissLines[i].type == LineType::MAIN)
-		{
-			sf::Vertex line[] =
-			{
-				sf::Vertex(sf::Vector2f(0,							posY), mainColor),
-				sf::Vertex(sf::Vector2f((float)m_data->windowWidth, posY), mainColor)
-			};
+	m_window->setView(*m_staticView);
 
-			m_window->draw(line, 2, sf::Lines);
-			m_window->draw(m_grid.m_abscissLines[i].valueLabelTxt);
-		}
-		else
-		{
-			sf::Vertex line[] =
-			{
-				sf::Vertex(sf::Vector2f(0,							posY), normalColor),
-				sf::Vertex(sf::Vector2f((float)m_data->windowWidth, posY), normalColor)
-			};
+	m_window->draw(m_grid.lines);
+	m_window->draw(m_grid.labels, &m_debugPanel.font->getTexture(DEBUG_FONT_SIZE));
+}
 
-			m_window->draw(line, 2, sf::Lines);
-			m_window->draw(m_grid.m_abscissLines[i].valueLabelTxt);
-		}
-	}
+void MainWindow::appendQuad(sf::VertexArray& vertices, sf::FloatRect rect, sf::Color color)
+{
+	sf::Vector2f topLeft(rect.left, rect.top), bottomRight(rect.left + rect.width, rect.top + rect.height);
+	sf::Vector2f topRight(bottomRight.x, topLeft.y), bottomLeft(topLeft.x, bottomRight.y);
+
+	vertices.append(sf::Vertex(topLeft, color));
+	vertices.append(sf::Vertex(topRight, color));
+	vertices.append(sf::Vertex(bottomLeft, color));
+	vertices.append(sf::Vertex(bottomLeft, color));
+	vertices.append(sf::Vertex(topRight, color));
+	vertices.append(sf::Vertex(bottomRight, color));
+}
+
+void MainWindow::appendLabel(Grid& grid, const sf::Font& font, const std::string& text, sf::Vector2f position)
+{
+	auto cached = grid.labelCache.find(text);
 
-	for (unsigned int i(0); i < m_grid.m_ordinateLines.size(); i++)
+	// Same layout as sf::Text: glyphs on a baseline one character size below the position
+	if (cached == grid.labelCache.end())
 	{
-		float posX = (float)m_grid.m_ordinateLines[i].pos;
+		std::vector<sf::Vertex> quads;
+		float x(0.f), y((float)DEBUG_FONT_SIZE);
 
-		if (m_grid.m_ordinateLines[i].type == LineType::ABSOLUTE_MAIN)
+		for (unsigned int i(0); i < text.size(); i++)
 		{
-			sf::RectangleShape line(sf::Vector2f((float)m_data->windowHeight, 2));
+			const sf::Glyph& glyph(font.getGlyph((sf::Uint32)(unsigned char)text[i], DEBUG_FONT_SIZE, false));
 
-			line.setPosition(posX, 0);
-			line.setFillColor(mainColor);
-			line.rotate(90);
+			float left(x + glyph.bounds.left), top(y + glyph.bounds.top);
+			float right(left + glyph.bounds.width), bottom(top + glyph.bounds.height);
 
-			m_window->draw(line);
-			m_window->draw(m_grid.m_ordinateLines[i].valueLabelTxt);
-		}
-		else if (m_grid.m_ordinateLines[i].type == LineType::MAIN)
-		{
-			sf::Vertex line[] =
-			{
-				sf::Vertex(sf::Vector2f(posX, 0),							mainColor),
-				sf::Vertex(sf::Vector2f(posX, (float)m_data->windowHeight), mainColor)
-			};
+			float u0((float)glyph.textureRect.left), v0((float)glyph.textureRect.top);
+			float u1(u0 + (float)glyph.textureRect.width), v1(v0 + (float)glyph.textureRect.height);
 
-			m_window->draw(line, 2, sf::Lines);
-			m_window->draw(m_grid.m_ordinateLines[i].valueLabelTxt);
-		}
-		else
-		{
-			sf::Vertex line[] =
-			{
-				sf::Vertex(sf::Vector2f(posX, 0),							normalColor),
-				sf::Vertex(sf::Vector2f(posX, (float)m_data->windowHeight), normalColor)
-			};
+			quads.push_back(sf::Vertex(sf::Vector2f(left, top), sf::Color::White, sf::Vector2f(u0, v0)));
+			quads.push_back(sf::Vertex(sf::Vector2f(right, top), sf::Color::White, sf::Vector2f(u1, v0)));
+			quads.push_back(sf::Vertex(sf::Vector2f(left, bottom), sf::Color::White, sf::Vector2f(u0, v1)));
+			quads.push_back(sf::Vertex(sf::Vector2f(left, bottom), sf::Color::White, sf::Vector2f(u0, v1)));
+			quads.push_back(sf::Vertex(sf::Vector2f(right, top), sf::Color::White, sf::Vector2f(u1, v0)));
+			quads.push_back(sf::Vertex(sf::Vector2f(right, bottom), sf::Color::White, sf::Vector2f(u1, v1)));
 
-			m_window->draw(line, 2, sf::Lines);
-			m_window->draw(m_grid.m_ordinateLines[i].valueLabelTxt);
+			x += glyph.advance;
 		}
+
+		cached = grid.labelCache.emplace(text, quads).first;
+	}
+
+	for (unsigned int i(0); i < cached->second.size(); i++)
+	{
+		sf::Vertex vertex(cached->second[i]);
+		vertex.position += position;
+
+		grid.labels.append(vertex);
 	}
 }
 
@@ -459,6 +573,11 @@ void MainWindow::initDebugPanel()
 	m_debugPanel.zoomTxt->setFont(*m_debugPanel.font);
 	m_debugPanel.zoomTxt->setCharacterSize(DEBUG_FONT_SIZE);
 
+	m_debugPanel.perfTxt = new sf::Text();
+	m_debugPanel.perfTxt->setFont(*m_debugPanel.font);
+	m_debugPanel.perfTxt->setCharacterSize(DEBUG_FONT_SIZE);
+	m_debugPanel.perfTxt->setString("-- Performance --");
+
 	m_debugPanel.helpTxt = new sf::Text();
 	m_debugPanel.helpTxt->setFont(*m_debugPanel.font);
 	m_debugPanel.helpTxt->setCharacterSize(DEBUG_FONT_SIZE);
@@ -475,8 +594,8 @@ void MainWindow::drawDebugInfo()
 	lastPosY += m_debugPanel.fpsTxt->getGlobalBounds().height + DEBUG_SPACING;
 
 	std::string plotBoundsStr("-- Plot bounds --\n");
-	plotBoundsStr += "X: [" + std::to_string(m_data->plotBounds.xMin) + " ; " + std::to_string(m_data->plotBounds.xMax) + "]\n";
-	plotBoundsStr += "Y: [" + std::to_string(m_data->plotBounds.yMin) + " ; " + std::to_string(m_data->plotBounds.yMax) + "]";
+	plotBoundsStr += "X: [" + std::to_string(m_camera.bounds.xMin) + " ; " + std::to_string(m_camera.bounds.xMax) + "]\n";
+	plotBoundsStr += "Y: [" + std::to_string(m_camera.bounds.yMin) + " ; " + std::to_string(m_camera.bounds.yMax) + "]";
 	m_debugPanel.plotBoundsTxt->setString(plotBoundsStr);
 	m_debugPanel.plotBoundsTxt->setPosition(0, lastPosY + 5 * DEBUG_SPACING);
 	lastPosY += m_debugPanel.plotBoundsTxt->getGlobalBounds().height + 6 * DEBUG_SPACING;
@@ -490,11 +609,35 @@ void MainWindow::drawDebugInfo()
 	m_debugPanel.cameraPosTxt->setPosition(0, lastPosY);
 	lastPosY += m_debugPanel.cameraPosTxt->getGlobalBounds().height + DEBUG_SPACING;
 
-	m_debugPanel.zoomTxt->setString("Zoom: " + std::to_string(m_zoom));
+	m_debugPanel.zoomTxt->setString("Zoom: " + std::to_string(m_zoom) + "\nRender scale: 1/" + std::to_string(m_renderScale));
 	m_debugPanel.zoomTxt->setPosition(0, lastPosY);
 	lastPosY += m_debugPanel.zoomTxt->getGlobalBounds().height + DEBUG_SPACING;
 
-	m_debugPanel.helpTxt->setString("Debug panel: F3\nGrid: G\nMove: Mouse left click\nZoom: Mouse scrollwheel");
+	// The numbers only change once per report, the histogram sits under them
+	if (m_data->stats.isReportDue())
+		updatePerfReport();
+
+	m_debugPanel.perfTxt->setPosition(0, lastPosY + 5 * DEBUG_SPACING);
+	lastPosY += m_debugPanel.perfTxt->getGlobalBounds().height + 7 * DEBUG_SPACING;
+
+	unsigned int tallestBin(1);
+	for (unsigned int i(0); i < PERF_HISTOGRAM_BINS; i++)
+		tallestBin = std::max(tallestBin, m_debugPanel.perfReport.histogram[i]);
+
+	m_debugPanel.histogram.clear();
+	appendQuad(m_debugPanel.histogram, sf::FloatRect(0.f, lastPosY + PERF_HISTOGRAM_HEIGHT, PERF_HISTOGRAM_BINS * PERF_HISTOGRAM_BAR_WIDTH, 1.f), sf::Color(150, 150, 150));
+
+	for (unsigned int i(0); i < PERF_HISTOGRAM_BINS; i++)
+	{
+		float barHeight(PERF_HISTOGRAM_HEIGHT * m_debugPanel.perfReport.histogram[i] / tallestBin);
+		sf::Color color(i < 1000.f / FPS_TARGET / PERF_HISTOGRAM_BIN_MS ? sf::Color(90, 200, 90) : sf::Color(220, 90, 90));
+
+		appendQuad(m_debugPanel.histogram, sf::FloatRect(i * PERF_HISTOGRAM_BAR_WIDTH, lastPosY + PERF_HISTOGRAM_HEIGHT - barHeight, PERF_HISTOGRAM_BAR_WIDTH - 1.f, barHeight), color);
+	}
+
+	lastPosY += PERF_HISTOGRAM_HEIGHT + DEBUG_SPACING;
+
+	m_debugPanel.helpTxt->setString("Debug panel: F3\nGrid: G\nTrace dump: F4 (with --trace)\nMove: Mouse left click\nZoom: Mouse scrollwheel");
 	m_debugPanel.helpTxt->setPosition(0, lastPosY + 5 * DEBUG_SPACING);
 	lastPosY += m_debugPanel.helpTxt->getGlobalBounds().height + 6 * DEBUG_SPACING;
 
@@ -505,9 +648,31 @@ void MainWindow::drawDebugInfo()
 	m_window->draw(*m_debugPanel.mousePlotPositionTxt);
 	m_window->draw(*m_debugPanel.cameraPosTxt);
 	m_window->draw(*m_debugPanel.zoomTxt);
+	m_window->draw(*m_debugPanel.perfTxt);
+	m_window->draw(m_debugPanel.histogram);
 	m_window->draw(*m_debugPanel.helpTxt);
 }
 
+void MainWindow::updatePerfReport()
+{
+	static const char* stageNames[(int)PerfStage::COUNT] = { "Tile", "Publish", "Upload", "Grid", "Text" };
+
+	PerfReport& report(m_debugPanel.perfReport);
+	m_data->stats.makeReport(report);
+
+	std::string perfStr("-- Performance --\n");
+	perfStr += "Frame: p50 " + decimal2str(report.frameP50) + " ms, p99 " + decimal2str(report.frameP99) + " ms\n";
+
+	for (unsigned int i(0); i < (unsigned int)PerfStage::COUNT; i++)
+		perfStr += std::string(stageNames[i]) + ": " + decimal2str((float)report.stageTime[i], 3) + " ms x " + std::to_string(report.stageCalls[i]) + "\n";
+
+	perfStr += "Pixels/s: " + decimal2str((float)(report.pixelsPerSecond * 1e-6)) + " M\n";
+	perfStr += "Workers: " + decimal2str((float)(report.utilization * 100.0), 0) + " % busy\n";
+	perfStr += "Frame times: 0 - " + decimal2str(PERF_HISTOGRAM_BINS * PERF_HISTOGRAM_BIN_MS, 0) + " ms";
+
+	m_debugPanel.perfTxt->setString(perfStr);
+}
+
 void MainWindow::deleteDebugPointers()
 {
 	delete m_debugPanel.font;
@@ -516,22 +681,41 @@ void MainWindow::deleteDebugPointers()
 	delete m_debugPanel.plotBoundsTxt;
 	delete m_debugPanel.cameraPosTxt;
 	delete m_debugPanel.zoomTxt;
+	delete m_debugPanel.perfTxt;
 	delete m_debugPanel.helpTxt;
 }
 
+void MainWindow::dumpTrace()
+{
+	if (!m_data->trace.isEnabled())
+	{
+		std::cout << "Tracing is off, start with --trace <file.json>" << std::endl;
+		return;
+	}
+
+	// Written from this thread, the frame it takes shows up in the next dump
+	if (m_data->trace.dump())
+		std::cout << "Trace written to " << m_data->trace.getOutput() << std::endl;
+	else
+		std::cerr << "Could not write the trace to " << m_data->trace.getOutput() << std::endl;
+}
+
 void MainWindow::getBounds()
 {
-	m_data->plotBounds.xMin = m_cameraPosition.x - m_dynamicView->getSize().x / 2;
-	m_data->plotBounds.xMax = m_cameraPosition.x + m_dynamicView->getSize().x / 2;
+	m_camera.bounds.xMin = m_cameraPosition.x - m_dynamicView->getSize().x / 2;
+	m_camera.bounds.xMax = m_cameraPosition.x + m_dynamicView->getSize().x / 2;
 
-	m_data->plotBounds.yMin = m_cameraPosition.y - m_dynamicView->getSize().y / 2;
-	m_data->plotBounds.yMax = m_cameraPosition.y + m_dynamicView->getSize().y / 2;
+	m_camera.bounds.yMin = m_cameraPosition.y - m_dynamicView->getSize().y / 2;
+	m_camera.bounds.yMax = m_cameraPosition.y + m_dynamicView->getSize().y / 2;
 }
 
-void MainWindow::resizePixelData()
+void MainWindow::submitCamera()
 {
-	delete m_data->pixels;
-	m_data->pixels = new sf::Uint8[m_data->windowWidth * m_data->windowHeight * 4];
+	getBounds();
+
+	// All the changes of this frame go out as one camera, the compute side only renders the latest
+	m_data->camera.submit(m_camera);
+	m_cameraChanged = false;
 }
 
 std::string MainWindow::decimal2str(float value, unsigned int precision)
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include <chrono>
 #include <thread>
+#include <unordered_map>
 
 #include "sharedData.h"
 
@@ -10,9 +12,26 @@
 #define DEFAULT_ZOOM 0.003f
 #define DEFAULT_CAMERA_POSITION sf::Vector2f(0.f, 0.f)
 
+// Label geometries kept for reuse, the cache starts over past this many different labels
+#define GRID_LABEL_CACHE_SIZE 1024
+
+// Vertical synchronization on top of the frame pacer
+#define WINDOW_VSYNC false
+
+// Seconds without camera movement before the plot goes back to full resolution
+#define INTERACTION_IDLE_DELAY 0.25f
+
+// Size of a frame time histogram bar in the debug panel, the tallest bin is PERF_HISTOGRAM_HEIGHT pixels
+#define PERF_HISTOGRAM_BAR_WIDTH 4.f
+#define PERF_HISTOGRAM_HEIGHT 40.f
+
 /*
-- Resize event modifies the window settings in the shared stucture (public method to read that data)
-- Use sf::Image to load pixel as quickly as possible
+- The loop sleeps until the next frame, and only redraws for input or a new frame from the compute side
+- Camera moves and resizes are gathered over a frame, then submitted to the compute side as a single camera
+- Only the rectangles changed since the last shown frame are uploaded, the texture is reallocated when the frame size changes
+- Frames are tiled, uploads go through a row ordered copy of the rectangle
+- The debug panel doubles as a performance HUD, stage timings are only measured while it is shown
+- F4 dumps the trace of the last spans of every thread, when started with --trace
 */
 
 namespace Display
@@ -37,7 +56,11 @@ namespace Display
 		sf::Text* plotBoundsTxt;
 		sf::Text* cameraPosTxt;
 		sf::Text* zoomTxt;
+		sf::Text* perfTxt;
 		sf::Text* helpTxt;
+
+		PerfReport perfReport;
+		sf::VertexArray histogram = sf::VertexArray(sf::Triangles);
 	};
 
 	enum class LineType { ABSOLUTE_MAIN = 0, MAIN, NORMAL };
@@ -48,8 +71,6 @@ namespace Display
 
 		int pos = 0;
 		float plotPos = 0;
-
-		sf::Text valueLabelTxt;
 	};
 
 	struct Grid
@@ -58,51 +79,74 @@ namespace Display
 
 		std::vector<Line> m_abscissLines;
 		std::vector<Line> m_ordinateLines;
+
+		// Built once per view change, drawn in one call each
+		sf::VertexArray lines = sf::VertexArray(sf::Triangles);
+		sf::VertexArray labels = sf::VertexArray(sf::Triangles);
+		std::unordered_map<std::string, std::vector<sf::Vertex>> labelCache;	// Glyph quads of a label, at the origin
+
+		bool built = false;
+		Bounds bounds = { 0.f, 0.f, 0.f, 0.f };
+		sf::Vector2u windowSize;
 	};
 
 	class MainWindow {
 	public:
-		MainWindow(SharedData* data);
+		MainWindow(SharedData* data, sf::Vector2f cameraPosition = DEFAULT_CAMERA_POSITION, float zoom = DEFAULT_ZOOM);
 		~MainWindow();
 
 		bool isOpen();
 
+		// No window needed, so they can also be measured on their own
+		static void computeGrid(Grid& grid, const Bounds& bounds, sf::Vector2u windowSize);
+		static void createGridLabels(Grid& grid, const sf::Font& font);
+
 	private:
 		void windowLoop();
-		bool timeForNextFrame();
+		void waitForNextFrame();
 
 		void handleEvents();
 		void checkCommands();
+		void updateCamera();
 		void update();
 		void updateScreenBuffer();
-		void computeGrid();
-		void createGridLabels();
+		void uploadRegion(const Frame& frame, const sf::IntRect& rect);
 		void drawGrid();
+		static void appendQuad(sf::VertexArray& vertices, sf::FloatRect rect, sf::Color color);
+		static void appendLabel(Grid& grid, const sf::Font& font, const std::string& text, sf::Vector2f position);
 
 		void initDebugPanel();
 		void drawDebugInfo();
+		void updatePerfReport();
+		void dumpTrace();
 		void deleteDebugPointers();
 
 		void getBounds();
-		void resizePixelData();
+		void submitCamera();
 
 		sf::View* m_dynamicView;
 		sf::View* m_staticView;
+		Camera m_camera;
+		bool m_cameraChanged;
 		sf::Vector2f m_cameraPosition;
 		float m_zoom;
 		bool m_moving;
+		sf::Clock m_interactionClock;
 		sf::Vector2i m_lastMousePosition;
 		Grid m_grid;
 
 		sf::RenderWindow* m_window;
-		sf::Image m_screenImage;
 		sf::Texture m_screenTexture;
+		std::vector<sf::IntRect> m_dirtyRegions;
+		std::vector<sf::Uint8> m_uploadBuffer;
 		sf::Sprite m_screenSprite;
+		unsigned int m_renderScale;
 		SharedData* m_data;
 
 		sf::Clock m_chrono;
-		sf::Time m_timePoint;
-		float m_framerate;
+		std::chrono::steady_clock::time_point m_nextFrame;
+		bool m_redraw;
+		float m_framerate;		// Of the redraws, which only happen on demand
 
 		bool m_showDebug;
 		DebugPanel m_debugPanel;
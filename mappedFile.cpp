@@ -0,0 +1,228 @@
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedFile.h"
+
+MappedFile::MappedFile()
+{
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+
+#if defined(_WIN32)
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = nullptr;
+#else
+	m_file = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::open(const std::string& path, bool writable)
+{
+	close();
+
+	m_file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	LARGE_INTEGER size;
+
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+	{
+		close();
+		return false;
+	}
+
+	m_size = (std::uint64_t)size.QuadPart;
+
+	return map(writable);
+}
+
+bool MappedFile::create(const std::string& path, std::uint64_t size)
+{
+	close();
+
+	m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		close();
+		return false;
+	}
+
+	m_size = size;
+
+	return map(true);
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+	m_size = 0;
+	m_open = false;
+}
+
+bool MappedFile::flush()
+{
+	return m_data == nullptr || (FlushViewOfFile(m_data, 0) && FlushFileBuffers(m_file));
+}
+
+bool MappedFile::flush(std::uint64_t offset, std::uint64_t size)
+{
+	// The range is widened to whole pages by the system
+	return m_data == nullptr || size == 0 || FlushViewOfFile(m_data + offset, (SIZE_T)size);
+}
+
+// PRIVATE
+bool MappedFile::map(bool writable)
+{
+	m_open = true;
+
+	if (m_size == 0)
+		return true;
+
+	// A writable mapping larger than the file extends it
+	m_mapping = CreateFileMappingA(m_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(m_size >> 32), (DWORD)m_size, nullptr);
+
+	if (m_mapping != nullptr)
+		m_data = static_cast<std::uint8_t*>(MapViewOfFile(m_mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+#else
+bool MappedFile::open(const std::string& path, bool writable)
+{
+	close();
+
+	m_file = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+
+	struct stat status;
+
+	if (m_file < 0 || fstat(m_file, &status) != 0)
+	{
+		close();
+		return false;
+	}
+
+	m_size = (std::uint64_t)status.st_size;
+
+	return map(writable);
+}
+
+bool MappedFile::create(const std::string& path, std::uint64_t size)
+{
+	close();
+
+	m_file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (m_file < 0 || ftruncate(m_file, (off_t)size) != 0)
+	{
+		close();
+		return false;
+	}
+
+	m_size = size;
+
+	return map(true);
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		munmap(m_data, (size_t)m_size);
+
+	if (m_file >= 0)
+		::close(m_file);
+
+	m_data = nullptr;
+	m_file = -1;
+	m_size = 0;
+	m_open = false;
+}
+
+bool MappedFile::flush()
+{
+	return m_data == nullptr || msync(m_data, (size_t)m_size, MS_SYNC) == 0;
+}
+
+bool MappedFile::flush(std::uint64_t offset, std::uint64_t size)
+{
+	if (m_data == nullptr || size == 0)
+		return true;
+
+	// msync wants a page aligned start
+	std::uint64_t page((std::uint64_t)sysconf(_SC_PAGESIZE));
+	std::uint64_t first(offset / page * page);
+
+	return msync(m_data + first, (size_t)(offset + size - first), MS_SYNC) == 0;
+}
+
+// PRIVATE
+bool MappedFile::map(bool writable)
+{
+	m_open = true;
+
+	if (m_size == 0)
+		return true;
+
+	void* address(mmap(nullptr, (size_t)m_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, m_file, 0));
+
+	if (address == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	m_data = static_cast<std::uint8_t*>(address);
+
+	return true;
+}
+#endif
+
+bool MappedFile::isOpen() const
+{
+	return m_open;
+}
+
+const std::uint8_t* MappedFile::data() const
+{
+	return m_data;
+}
+
+std::uint8_t* MappedFile::data()
+{
+	return m_data;
+}
+
+std::uint64_t MappedFile::size() const
+{
+	return m_size;
+}
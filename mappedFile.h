@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+- A whole file mapped in memory, pages are read from the disk on first access and dropped by the system under pressure
+- open() maps an existing file, read only unless asked, create() makes (or truncates) a file of the given size and maps it writable
+- Writable mappings are shared: other processes mapping the same file see the writes
+- An empty file opens fine, data() is then nullptr
+*/
+
+class MappedFile
+{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& path, bool writable = false);
+		bool create(const std::string& path, std::uint64_t size);
+		void close();
+
+		// Writes the pages of a created file back to the disk, all of them or those of a range (which can then be dropped without another write)
+		bool flush();
+		bool flush(std::uint64_t offset, std::uint64_t size);
+
+		bool isOpen() const;
+		const std::uint8_t* data() const;
+		std::uint8_t* data();
+		std::uint64_t size() const;
+
+	private:
+		bool map(bool writable);
+
+		std::uint8_t* m_data;
+		std::uint64_t m_size;
+		bool m_open;
+
+#if defined(_WIN32)
+		void* m_file;
+		void* m_mapping;
+#else
+		int m_file;
+#endif
+};
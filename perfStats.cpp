@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "perfStats.h"
+
+PerfStats::PerfStats()
+{
+	m_enabled = false;
+
+	for (unsigned int i(0); i < (unsigned int)PerfStage::COUNT; i++)
+	{
+		m_stageNanoseconds[i] = 0;
+		m_stageCalls[i] = 0;
+	}
+
+	m_pixels = 0;
+	m_capacityNanoseconds = 0;
+
+	m_frameTimes.reserve(PERF_FRAME_HISTORY);
+	m_nextFrame = 0;
+	m_lastReport = Clock::now();
+}
+
+void PerfStats::setEnabled(bool enabled)
+{
+	m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void PerfStats::addStage(PerfStage stage, Clock::duration elapsed)
+{
+	// Relaxed: the counters are only summed up, nothing else is published through them
+	m_stageNanoseconds[(int)stage].fetch_add((unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), std::memory_order_relaxed);
+	m_stageCalls[(int)stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PerfStats::addPixels(unsigned long long count)
+{
+	m_pixels.fetch_add(count, std::memory_order_relaxed);
+}
+
+void PerfStats::addWave(Clock::duration elapsed, unsigned int threadCount)
+{
+	m_capacityNanoseconds.fetch_add((unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * threadCount, std::memory_order_relaxed);
+}
+
+void PerfStats::addFrame(Clock::duration elapsed)
+{
+	float milliseconds(std::chrono::duration<float, std::milli>(elapsed).count());
+
+	// Ring buffer over the last PERF_FRAME_HISTORY frames
+	if (m_frameTimes.size() < PERF_FRAME_HISTORY)
+		m_frameTimes.push_back(milliseconds);
+	else
+		m_frameTimes[m_nextFrame] = milliseconds;
+
+	m_nextFrame = (m_nextFrame + 1) % PERF_FRAME_HISTORY;
+}
+
+bool PerfStats::isReportDue() const
+{
+	return std::chrono::duration<float>(Clock::now() - m_lastReport).count() >= PERF_REPORT_INTERVAL;
+}
+
+void PerfStats::makeReport(PerfReport& report)
+{
+	Clock::time_point now(Clock::now());
+	double seconds(std::chrono::duration<double>(now - m_lastReport).count());
+	m_lastReport = now;
+
+	unsigned long long busy(0);
+
+	for (unsigned int i(0); i < (unsigned int)PerfStage::COUNT; i++)
+	{
+		unsigned long long nanoseconds(m_stageNanoseconds[i].exchange(0, std::memory_order_relaxed));
+		unsigned long long calls(m_stageCalls[i].exchange(0, std::memory_order_relaxed));
+
+		report.stageCalls[i] = calls;
+		report.stageTime[i] = calls > 0 ? (double)nanoseconds / calls * 1e-6 : 0.0;
+
+		if (i == (unsigned int)PerfStage::TILE)
+			busy = nanoseconds;
+	}
+
+	unsigned long long pixels(m_pixels.exchange(0, std::memory_order_relaxed));
+	unsigned long long capacity(m_capacityNanoseconds.exchange(0, std::memory_order_relaxed));
+
+	report.pixelsPerSecond = seconds > 0.0 ? (double)pixels / seconds : 0.0;
+	report.utilization = capacity > 0 ? std::min((double)busy / (double)capacity, 1.0) : 0.0;
+
+	std::fill(report.histogram, report.histogram + PERF_HISTOGRAM_BINS, 0u);
+
+	for (unsigned int i(0); i < m_frameTimes.size(); i++)
+		report.histogram[std::min((unsigned int)(m_frameTimes[i] / PERF_HISTOGRAM_BIN_MS), (unsigned int)PERF_HISTOGRAM_BINS - 1)]++;
+
+	if (m_frameTimes.empty())
+	{
+		report.frameP50 = 0.f;
+		report.frameP99 = 0.f;
+		return;
+	}
+
+	// Only once per report, on a copy so the ring keeps its order
+	m_sortedFrameTimes = m_frameTimes;
+	std::sort(m_sortedFrameTimes.begin(), m_sortedFrameTimes.end());
+
+	unsigned int last((unsigned int)m_sortedFrameTimes.size() - 1);
+	report.frameP50 = m_sortedFrameTimes[last * 50 / 100];
+	report.frameP99 = m_sortedFrameTimes[last * 99 / 100];
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Redraws whose duration is kept for the histogram and the percentiles
+#define PERF_FRAME_HISTORY 240
+
+// The HUD shows averages over this many seconds
+#define PERF_REPORT_INTERVAL 0.5f
+
+// Frame time histogram: bins of PERF_HISTOGRAM_BIN_MS milliseconds, the last one takes everything slower
+#define PERF_HISTOGRAM_BINS 32
+#define PERF_HISTOGRAM_BIN_MS 1.f
+
+/*
+- Counters fed by the compute and window threads, summed up and reset by the window once per report
+- Every measure is behind isEnabled(): while the HUD is hidden, a stage costs one relaxed load and no clock read
+- Tile times are summed over the workers, their total over the wall time of the waves times the thread count is the utilization
+- Frame times stay on the window thread, they need no synchronization
+*/
+
+enum class PerfStage { TILE = 0, PUBLISH, UPLOAD, GRID, TEXT, COUNT };
+
+struct PerfReport
+{
+	double stageTime[(int)PerfStage::COUNT] = {};		// Average per call, in milliseconds
+	unsigned long long stageCalls[(int)PerfStage::COUNT] = {};
+	double pixelsPerSecond = 0.0;
+	double utilization = 0.0;							// 0 to 1, 0 when nothing was computed
+	float frameP50 = 0.f;								// In milliseconds
+	float frameP99 = 0.f;
+	unsigned int histogram[PERF_HISTOGRAM_BINS] = {};
+};
+
+class PerfStats
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		PerfStats();
+
+		void setEnabled(bool enabled);
+		bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+		// Any thread
+		void addStage(PerfStage stage, Clock::duration elapsed);
+		void addPixels(unsigned long long count);
+		void addWave(Clock::duration elapsed, unsigned int threadCount);
+
+		// Window thread
+		void addFrame(Clock::duration elapsed);
+		bool isReportDue() const;
+		void makeReport(PerfReport& report);
+
+	private:
+		std::atomic<bool> m_enabled;
+
+		std::atomic<unsigned long long> m_stageNanoseconds[(int)PerfStage::COUNT];
+		std::atomic<unsigned long long> m_stageCalls[(int)PerfStage::COUNT];
+		std::atomic<unsigned long long> m_pixels;
+		std::atomic<unsigned long long> m_capacityNanoseconds;		// Wave wall time times the thread count
+
+		std::vector<float> m_frameTimes;
+		std::vector<float> m_sortedFrameTimes;
+		unsigned int m_nextFrame;
+		Clock::time_point m_lastReport;
+};
+
+// Measures its scope into a stage, only reads the clock when the stats are enabled
+class PerfTimer
+{
+	public:
+		PerfTimer(PerfStats& stats, PerfStage stage) : m_stats(stats), m_stage(stage), m_enabled(stats.isEnabled())
+		{
+			if (m_enabled)
+				m_start = PerfStats::Clock::now();
+		}
+
+		~PerfTimer()
+		{
+			if (m_enabled)
+				m_stats.addStage(m_stage, PerfStats::Clock::now() - m_start);
+		}
+
+	private:
+		PerfStats& m_stats;
+		PerfStage m_stage;
+		bool m_enabled;
+		PerfStats::Clock::time_point m_start;
+};
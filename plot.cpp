@@ -1,90 +1,701 @@
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
 
 #include "plot.h"
+#include "imageWriter.h"
 
-Plot::Plot(SharedData *data)
+PlotBase::PlotBase(SharedData *data, unsigned int threadCount) : m_cache(TILE_SIZE), m_pool(threadCount)
 {
 	m_data = data;
 
+	m_simdLevel = Simd::detectLevel();
+	m_progressive = true;
+
 	initData();
 }
 
-void Plot::compute()
+PlotBase::~PlotBase()
 {
-    sf::Vector2f coord;
+	m_preview.release();
+}
+
+void PlotBase::computeTiles(const std::function<void(const PendingRegion&, unsigned int)>& computeTile)
+{
+    std::vector<PendingRegion> tiles;
+
+    reuseFrame();
+
+    for (unsigned int i(0); i < m_pending.size(); i++)
+        splitIntoTiles(m_pending[i], tiles);
+
+    fetchCachedTiles(tiles);
+
+    // Center first, where the eye is after a zoom
+    sf::Vector2i center((int)m_renderWidth / 2, (int)m_renderHeight / 2);
+    std::sort(tiles.begin(), tiles.end(), [center](const PendingRegion& a, const PendingRegion& b)
+    {
+        return distanceSquared(a.rect, center) < distanceSquared(b.rect, center);
+    });
+
+    unsigned int waveSize(m_pool.getThreadCount() * TILES_PER_WAVE);
+    std::vector<unsigned int> levelTiles;
+
+    sf::Clock publishClock;
+    sf::Clock frameClock;
+    unsigned int pendingArea(0);
+
+    for (unsigned int i(0); i < tiles.size(); i++)
+    {
+        if (tiles[i].step != 1)
+            pendingArea += (unsigned int)(tiles[i].rect.width * tiles[i].rect.height);
+    }
+
+    m_cancelled = false;
+
+    // Coarse to fine: every level covers the whole pending area before the next one starts
+    for (unsigned int step(PROGRESSIVE_MAX_STEP); step >= 1 && !m_cancelled; step /= 2)
+    {
+        levelTiles.clear();
+        for (unsigned int i(0); i < tiles.size(); i++)
+        {
+            if (nextStep(tiles[i]) == step)
+                levelTiles.push_back(i);
+        }
+
+        unsigned int tileCount((unsigned int)levelTiles.size());
+
+        // Tiles go out in waves so the frame can be published while it is still being computed
+        for (unsigned int first(0); first < tileCount && !m_cancelled; first += waveSize)
+        {
+            bool measured(m_data->stats.isEnabled());
+            PerfStats::Clock::time_point waveStart;
+
+            if (measured)
+                waveStart = PerfStats::Clock::now();
+
+            m_pool.parallelFor(std::min(waveSize, tileCount - first), [this, &computeTile, &tiles, &levelTiles, first, step](unsigned int i)
+            {
+                if (tileCancelled())
+                    return;
+
+                PendingRegion& tile(tiles[levelTiles[first + i]]);
+
+                {
+                    TraceSpan span(m_data->trace, "tile");
+                    PerfTimer timer(m_data->stats, PerfStage::TILE);
+                    computeTile(tile, step);
+                }
+
+                tile.step = step;
+
+                // Samples evaluated, one per step x step block
+                if (m_data->stats.isEnabled())
+                    m_data->stats.addPixels((unsigned long long)tile.rect.width * tile.rect.height / (step * step));
+            });
+
+            if (measured)
+                m_data->stats.addWave(PerfStats::Clock::now() - waveStart, m_pool.getThreadCount());
+
+            // Cancelled tiles are marked too, an unchanged rectangle only costs its upload
+            for (unsigned int i(first); i < std::min(first + waveSize, tileCount); i++)
+                m_data->frameBuffer.markDirty(tiles[levelTiles[i]].rect);
+
+            if (publishClock.getElapsedTime().asSeconds() >= 1.f / FPS_TARGET)
+            {
+                publish();
+                publishClock.restart();
+            }
+        }
+
+        if (tileCount > 0 && step > 1 && !m_cancelled)
+        {
+            publish();
+            publishClock.restart();
+        }
+    }
+
+    // Whatever a cancellation left behind is resumed (or scrolled along) by the next compute
+    m_pending.clear();
+    for (unsigned int i(0); i < tiles.size(); i++)
+    {
+        if (tiles[i].step != 1)
+            m_pending.push_back(tiles[i]);
+    }
+
+    publish();
+
+    if (!m_cancelled)
+    {
+        measurePixelCost(frameClock.getElapsedTime().asSeconds(), pendingArea);
+
+        if (m_pending.empty())
+            storeCachedTiles();
+    }
+}
+
+TileKey PlotBase::tileKey(int x, int y) const
+{
+    TileKey key;
+    long long gridX(m_gridX + x), gridY(m_gridY + y);
+
+    key.levelX = m_levelX;
+    key.levelY = m_levelY;
+    key.tileX = (gridX - ((gridX % TILE_SIZE) + TILE_SIZE) % TILE_SIZE) / TILE_SIZE;
+    key.tileY = (gridY - ((gridY % TILE_SIZE) + TILE_SIZE) % TILE_SIZE) / TILE_SIZE;
+
+    return key;
+}
+
+void PlotBase::fetchCachedTiles(std::vector<PendingRegion>& tiles)
+{
+    for (unsigned int i(0); i < tiles.size(); i++)
+    {
+        PendingRegion& tile(tiles[i]);
+
+        if (tile.step == 1)
+            continue;
+
+        TileKey key(tileKey(tile.rect.left, tile.rect.top));
+        const sf::Color* cached(m_cache.find(key));
+
+        if (cached == nullptr)
+            continue;
+
+        // Tiles never straddle world tiles (see splitIntoTiles()), so the cached one covers it
+        int originX((int)(key.tileX * TILE_SIZE - m_gridX)), originY((int)(key.tileY * TILE_SIZE - m_gridY));
+
+        for (int y(tile.rect.top); y < tile.rect.top + tile.rect.height; y++)
+        {
+            const sf::Color* source(cached + (tile.rect.left - originX) + (y - originY) * TILE_SIZE);
+            sf::Color* destination(m_frame->pixelAt((unsigned int)tile.rect.left, (unsigned int)y));
+
+            std::copy(source, source + tile.rect.width, destination);
+        }
+
+        m_data->frameBuffer.markDirty(tile.rect);
+        tile.step = 1;
+    }
+}
+
+void PlotBase::storeCachedTiles()
+{
+    // Only world tiles entirely inside the frame, the edges are cut
+    int firstX((int)((TILE_SIZE - (m_gridX % TILE_SIZE + TILE_SIZE) % TILE_SIZE) % TILE_SIZE));
+    int firstY((int)((TILE_SIZE - (m_gridY % TILE_SIZE + TILE_SIZE) % TILE_SIZE) % TILE_SIZE));
+
+    for (int y(firstY); y + TILE_SIZE <= (int)m_renderHeight; y += TILE_SIZE)
+    {
+        for (int x(firstX); x + TILE_SIZE <= (int)m_renderWidth; x += TILE_SIZE)
+        {
+            TileKey key(tileKey(x, y));
+
+            if (!m_cache.contains(key))
+                m_cache.store(key, m_frame->pixelAt((unsigned int)x, (unsigned int)y), TILE_SIZE);
+        }
+    }
+}
+
+bool PlotBase::renderStripes(const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height, const BlockFunction& renderBlock)
+{
+    ImageWriter writer;
+
+    if (width == 0 || height == 0 || !writer.open(path, width, height))
+        return false;
+
+    std::vector<sf::Color> stripes[2];
+    std::future<bool> written;
+    bool success(true);
+
+    for (unsigned int top(0), index(0); top < height && success; top += BATCH_STRIPE_HEIGHT, index++)
+    {
+        unsigned int rows(std::min((unsigned int)BATCH_STRIPE_HEIGHT, height - top));
+        std::vector<sf::Color>& stripe(stripes[index % 2]);
+
+        stripe.resize((std::size_t)width * rows);
+
+        renderArea(bounds, width, height, sf::IntRect(0, (int)top, (int)width, (int)rows), stripe.data(), width, renderBlock);
+
+        // The previous stripe was written while this one was computed
+        if (written.valid())
+            success = written.get();
+
+        const sf::Uint8* pixels(reinterpret_cast<const sf::Uint8*>(stripe.data()));
+        written = std::async(std::launch::async, [&writer, pixels, rows] { return writer.writeRows(pixels, rows); });
+
+        std::cout << "\rRendering: " << (unsigned int)((unsigned long long)(top + rows) * 100 / height) << "%" << std::flush;
+    }
+
+    if (written.valid())
+        success = written.get() && success;
+
+    std::cout << std::endl;
+
+    return writer.close() && success;
+}
+
+void PlotBase::renderArea(const Bounds& bounds, unsigned int width, unsigned int height, const sf::IntRect& area, sf::Color* pixels, unsigned int stride,
+    const BlockFunction& renderBlock)
+{
+    // In double, a float origin would drift by whole pixels across a gigapixel image
+    renderArea(bounds.xMin, bounds.yMin, ((double)bounds.xMax - bounds.xMin) / width, ((double)bounds.yMax - bounds.yMin) / height, area, pixels, stride, renderBlock);
+}
+
+void PlotBase::renderArea(double xMin, double yMin, double dx, double dy, const sf::IntRect& area, sf::Color* pixels, unsigned int stride,
+    const BlockFunction& renderBlock, long long gridX, long long gridY)
+{
+    // Blocks of up to TILE_SIZE x TILE_SIZE on the image grid, whatever the area: every caller gets the same pixels
+    unsigned int columns(((unsigned int)area.width + TILE_SIZE - 1) / TILE_SIZE);
+    unsigned int blockRows(((unsigned int)area.height + TILE_SIZE - 1) / TILE_SIZE);
+
+    m_pool.parallelFor(columns * blockRows, [&renderBlock, &area, pixels, stride, xMin, yMin, dx, dy, gridX, gridY, columns](unsigned int block)
+    {
+        unsigned int x((block % columns) * TILE_SIZE);
+        unsigned int y((block / columns) * TILE_SIZE);
+        unsigned int left((unsigned int)area.left + x);
+        unsigned int top((unsigned int)area.top + y);
+
+        Affine origin;
+        origin.x0 = (float)(xMin + left * dx);
+        origin.dx = (float)dx;
+        origin.y0 = (float)(yMin + top * dy);
+        origin.dy = (float)dy;
+
+        renderBlock(origin, gridX + left, gridY + top, std::min((unsigned int)TILE_SIZE, (unsigned int)area.width - x), std::min((unsigned int)TILE_SIZE, (unsigned int)area.height - y),
+            pixels + (std::size_t)y * stride + x, stride);
+    });
+}
+
+std::string PlotBase::farmIdentity(const char* kernelType, const std::string& kernelIdentity) const
+{
+    std::string bytes(kernelIdentity);
+    bytes.append(reinterpret_cast<const char*>(&m_adaptive.depth), sizeof(m_adaptive.depth));
+    bytes.append(reinterpret_cast<const char*>(&m_adaptive.threshold), sizeof(m_adaptive.threshold));
+    bytes.append(reinterpret_cast<const char*>(&m_adaptive.fill), sizeof(m_adaptive.fill));
+
+    // FNV-1a, the kernel identity can be a whole tile of texels
+    unsigned long long hash(14695981039346656037ull);
+
+    for (char byte : bytes)
+        hash = (hash ^ (unsigned char)byte) * 1099511628211ull;
+
+    char digits[17];
+    std::snprintf(digits, sizeof(digits), "%016llx", hash);
+
+    return std::string(kernelType) + " " + digits;
+}
+
+void PlotBase::measurePixelCost(float seconds, unsigned int pixels)
+{
+    // Strips of a few pixels are dominated by overhead, they say little about the kernel
+    if (pixels < m_renderWidth * m_renderHeight / 16)
+        return;
+
+    // Cost of one kernel call, the same whatever the resolution it was measured at
+    float cost(seconds / (float)pixels);
+
+    m_pixelCost = m_pixelCost > 0.f ? 0.5f * (m_pixelCost + cost) : cost;
+}
+
+void PlotBase::chooseResolution()
+{
+    if (!m_interacting || m_pixelCost <= 0.f)
+    {
+        m_resolutionDivisor = 1;
+        return;
+    }
+
+    float budget(RESOLUTION_FRAME_BUDGET);
+    float fullFrameCost(m_pixelCost * (float)m_windowWidth * (float)m_windowHeight);
+    unsigned int divisor(1);
+
+    while (divisor < RESOLUTION_MAX_DIVISOR && fullFrameCost / (float)(divisor * divisor) > budget)
+        divisor *= 2;
+
+    // Going up in resolution costs a full recompute, only do it with plenty of headroom
+    if (divisor > m_resolutionDivisor || fullFrameCost / (float)(divisor * divisor) < 0.5f * budget)
+        m_resolutionDivisor = divisor;
+}
+
+unsigned int PlotBase::nextStep(const PendingRegion& region) const
+{
+    // Adaptive sampling is already cheap, and a block kernel has no coarser level: straight to the full resolution
+    if ((m_adaptive.depth > 0 || !m_progressive) && region.step != 1)
+        return 1;
+
+    // A previewed region already shows a complete image, coarse blocks would only make it worse
+    if (region.step == 0)
+        return region.preview ? 1 : PROGRESSIVE_MAX_STEP;
+
+    return region.step / 2;
+}
+
+void PlotBase::reuseFrame()
+{
+    int offsetX(0), offsetY(0);
 
-    updatePlotSettings();
+    bool sameSize(m_frame->width == m_renderWidth && m_frame->height == m_renderHeight);
 
-    for (unsigned int x(0); x < m_windowWidth; x++)
+    bool preview(false);
+
+    if (m_frameValid && sameSize && isTranslation(offsetX, offsetY))
+    {
+        if (offsetX != 0 || offsetY != 0)
+            scrollFrame(offsetX, offsetY);
+    }
+    else
     {
-        for (unsigned int y(0); y < m_windowHeight; y++)
+        // Zoom or resolution change: show the previous frame rescaled right away, the exact pixels replace it as they come
+        if (m_frameValid)
         {
-            if (m_data->eventType == Event::CAMERA_MOVED || m_data->eventType == Event::WINDOW_RESIZED)
-                return;
-            
-            coord = screenToWorld(x, y);
+            previewFrame(m_frameAffine, m_affine);
+            preview = true;
+        }
+        else
+        {
+            resizePixelData();
+        }
+
+        PendingRegion full;
+        full.rect = sf::IntRect(0, 0, (int)m_renderWidth, (int)m_renderHeight);
+        full.preview = m_frameValid;
+
+        m_pending.clear();
+        m_pending.push_back(full);
+    }
+
+    // Even a pan moves the grid by a fraction of a pixel relative to the bounds
+    m_frame->scale = m_scale;
+    m_frame->offset = m_offset;
+
+    if (preview)
+        publish();
+
+    m_frameAffine = m_affine;
+    m_frameGridX = m_gridX;
+    m_frameGridY = m_gridY;
+    m_frameLevelX = m_levelX;
+    m_frameLevelY = m_levelY;
+    m_frameValid = true;
+}
+
+void PlotBase::previewFrame(const Affine& from, const Affine& to)
+{
+    std::vector<int> sourceX(m_renderWidth), sourceY(m_renderHeight);
+    std::vector<unsigned int> destinationX(m_renderWidth);
+    unsigned int sourceWidth(m_frame->width), sourceHeight(m_frame->height);
+
+    m_preview.resize(m_renderWidth, m_renderHeight);
+    alignFrame(m_preview);
+
+    // The tiled layout is separable: a pixel is at its row's offset plus its column's offset.
+    // Offsets of the nearest source pixel of every column and row, -1 when it falls outside the previous frame
+    for (unsigned int x(0); x < m_renderWidth; x++)
+    {
+        int source((int)floorf((to.x0 + ((float)x + 0.5f) * to.dx - from.x0) / from.dx));
+        sourceX[x] = (source >= 0 && source < (int)sourceWidth) ? (int)m_frame->columnOffset((unsigned int)source) : -1;
+        destinationX[x] = m_preview.columnOffset(x);
+    }
+
+    for (unsigned int y(0); y < m_renderHeight; y++)
+    {
+        int source((int)floorf((to.y0 + ((float)y + 0.5f) * to.dy - from.y0) / from.dy));
+        sourceY[y] = (source >= 0 && source < (int)sourceHeight) ? (int)m_frame->rowOffset((unsigned int)source) : -1;
+    }
 
-            // YOUR WORK HERE
+    const sf::Color* source(reinterpret_cast<const sf::Color*>(m_frame->pixels));
+    sf::Color* destination(reinterpret_cast<sf::Color*>(m_preview.pixels));
+    const Frame& preview(m_preview);
+    unsigned int width(m_renderWidth);
 
-            setPixelColor(x, y, sf::Color(10, 10, 10));
+    m_pool.parallelFor(m_renderHeight, [&sourceX, &sourceY, &destinationX, &preview, source, destination, width](unsigned int y)
+    {
+        sf::Color* row(destination + preview.rowOffset(y));
+
+        if (sourceY[y] < 0)
+        {
+            for (unsigned int x(0); x < width; x++)
+                row[destinationX[x]] = BACKGROUND_COLOR;
+
+            return;
         }
+
+        const sf::Color* sourceRow(source + sourceY[y]);
+
+        for (unsigned int x(0); x < width; x++)
+            row[destinationX[x]] = sourceX[x] < 0 ? BACKGROUND_COLOR : sourceRow[sourceX[x]];
+    });
+
+    // Both frames belong to the compute side, so the storage can simply change hands
+    std::swap(*m_frame, m_preview);
+    m_data->frameBuffer.markAllDirty();
+}
+
+void PlotBase::scrollFrame(int offsetX, int offsetY)
+{
+    int width((int)m_renderWidth), height((int)m_renderHeight);
+
+    if (abs(offsetX) >= width || abs(offsetY) >= height)
+    {
+        // Nothing is kept, the tiles only have to follow the grid
+        alignFrame(*m_frame);
+
+        PendingRegion full;
+        full.rect = sf::IntRect(0, 0, width, height);
+
+        m_pending.clear();
+        m_pending.push_back(full);
+        return;
+    }
+
+    m_frame->scroll(offsetX, offsetY);
+    m_data->frameBuffer.markAllDirty();
+
+    // Pending regions move along with the pixels, the sample lattice stays on the world grid
+    std::vector<PendingRegion> scrolled;
+    for (unsigned int i(0); i < m_pending.size(); i++)
+    {
+        PendingRegion region(m_pending[i]);
+
+        int left(std::max(region.rect.left - offsetX, 0));
+        int top(std::max(region.rect.top - offsetY, 0));
+        int right(std::min(region.rect.left + region.rect.width - offsetX, width));
+        int bottom(std::min(region.rect.top + region.rect.height - offsetY, height));
+
+        if (left >= right || top >= bottom)
+            continue;
+
+        region.rect = sf::IntRect(left, top, right - left, bottom - top);
+        scrolled.push_back(region);
     }
 
-    m_data->eventType = Event::NONE;
+    // Exposed strips: full height columns, then rows without the columns' corner
+    int keptLeft(std::max(-offsetX, 0)), keptRight(std::min(width - offsetX, width));
+
+    PendingRegion strip;
+
+    if (offsetX != 0)
+    {
+        strip.rect = sf::IntRect(offsetX > 0 ? width - offsetX : 0, 0, abs(offsetX), height);
+        scrolled.push_back(strip);
+    }
+
+    if (offsetY != 0)
+    {
+        strip.rect = sf::IntRect(keptLeft, offsetY > 0 ? height - offsetY : 0, keptRight - keptLeft, abs(offsetY));
+        scrolled.push_back(strip);
+    }
+
+    m_pending = scrolled;
 }
 
-void Plot::initData()
+void PlotBase::alignFrame(Frame& frame) const
 {
-    m_data->pixels = new sf::Uint8[DEFAULT_WIN_WIDTH * DEFAULT_WIN_HEIGHT * 4];
+    // Storage tiles on the world tiles
+    frame.setPhase((unsigned int)((m_gridX % TILE_SIZE + TILE_SIZE) % TILE_SIZE), (unsigned int)((m_gridY % TILE_SIZE + TILE_SIZE) % TILE_SIZE));
+}
 
-    int index(0);
-    for (unsigned int x(0); x < DEFAULT_WIN_WIDTH; x++)
+bool PlotBase::isTranslation(int& offsetX, int& offsetY) const
+{
+    // Same pixel size means the same grid, the offset is then a whole number of pixels
+    if (m_levelX != m_frameLevelX || m_levelY != m_frameLevelY)
+        return false;
+
+    long long pixelsX(m_gridX - m_frameGridX), pixelsY(m_gridY - m_frameGridY);
+
+    // Anything beyond the frame is a full recompute anyway
+    offsetX = (int)std::max(std::min(pixelsX, (long long)m_renderWidth), -(long long)m_renderWidth);
+    offsetY = (int)std::max(std::min(pixelsY, (long long)m_renderHeight), -(long long)m_renderHeight);
+
+    return true;
+}
+
+int PlotBase::distanceSquared(const sf::IntRect& rect, sf::Vector2i point)
+{
+    int dx(rect.left + rect.width / 2 - point.x);
+    int dy(rect.top + rect.height / 2 - point.y);
+
+    return dx * dx + dy * dy;
+}
+
+void PlotBase::splitIntoTiles(const PendingRegion& region, std::vector<PendingRegion>& tiles) const
+{
+    const sf::IntRect& rect(region.rect);
+    PendingRegion tile(region);
+
+    // Cut along the world tiles, so a tile is cached and found again whatever the view it was computed in
+    for (int y(rect.top); y < rect.top + rect.height; y += tile.rect.height)
     {
-        for (unsigned int y(0); y < DEFAULT_WIN_HEIGHT; y++)
+        int tileBottom(y + TILE_SIZE - (int)((m_gridY + y) % TILE_SIZE + TILE_SIZE) % TILE_SIZE);
+
+        for (int x(rect.left); x < rect.left + rect.width; x += tile.rect.width)
         {
-            index = (x + y * DEFAULT_WIN_WIDTH) * 4;
+            int tileRight(x + TILE_SIZE - (int)((m_gridX + x) % TILE_SIZE + TILE_SIZE) % TILE_SIZE);
+
+            tile.rect = sf::IntRect(x, y,
+                std::min(tileRight, rect.left + rect.width) - x,
+                std::min(tileBottom, rect.top + rect.height) - y);
 
-            m_data->pixels[index] = 10;
-            m_data->pixels[index + 1] = 10;
-            m_data->pixels[index + 2] = 10;
-            m_data->pixels[index + 3] = 255;
+            tiles.push_back(tile);
         }
     }
 }
 
-void Plot::updatePlotSettings()
+bool PlotBase::tileCancelled()
+{
+    if (m_cancelled)
+        return true;
+
+    // A newer camera makes the rest of this one useless, checked once per tile
+    if (m_data->camera.getGeneration() != m_generation)
+    {
+        m_cancelled = true;
+        return true;
+    }
+
+    return false;
+}
+
+void PlotBase::initData()
 {
-    m_data->mutex.lock();
+    m_frame = &m_data->frameBuffer.back();
+    m_frame->resize(DEFAULT_WIN_WIDTH, DEFAULT_WIN_HEIGHT);
+    m_frame->fill(BACKGROUND_COLOR);
 
-    m_data->eventType = Event::NONE;
+    m_windowWidth = DEFAULT_WIN_WIDTH;
+    m_windowHeight = DEFAULT_WIN_HEIGHT;
+    m_renderWidth = DEFAULT_WIN_WIDTH;
+    m_renderHeight = DEFAULT_WIN_HEIGHT;
+    m_gridX = 0;
+    m_gridY = 0;
+    m_levelX = 0;
+    m_levelY = 0;
+    m_scale = sf::Vector2f(1.f, 1.f);
+    m_frameValid = false;
 
-    m_plotBounds = m_data->plotBounds;
-    m_windowWidth = m_data->windowWidth;
-    m_windowHeight = m_data->windowHeight;
+    m_generation = 0;
+    m_interacting = false;
+    m_resolutionDivisor = 1;
+    m_pixelCost = 0.f;
 
-    m_data->mutex.unlock();
+    publish();
 }
 
-void Plot::setPixelColor(unsigned int x, unsigned int y, sf::Color color)
+void PlotBase::publish()
 {
-    m_data->mutex.lock();
+    TraceSpan span(m_data->trace, "publish");
+    PerfTimer timer(m_data->stats, PerfStage::PUBLISH);
+
+    m_data->frameBuffer.publish();
+    m_frame = &m_data->frameBuffer.back();
+}
+
+void PlotBase::updatePlotSettings()
+{
+    TraceSpan span(m_data->trace, "updatePlotSettings");
+
+    // A snapshot, the window may submit the next camera while this one is rendered
+    Camera camera(m_data->camera.latest());
+
+    m_generation = camera.generation;
+    m_plotBounds = camera.bounds;
+    m_windowWidth = camera.windowWidth;
+    m_windowHeight = camera.windowHeight;
+    m_interacting = camera.interacting;
+
+    // While the camera moves, render fewer pixels so a frame fits in the budget, the window upscales them
+    chooseResolution();
+
+    double windowDx(((double)m_plotBounds.xMax - m_plotBounds.xMin) / m_windowWidth);
+    double windowDy(((double)m_plotBounds.yMax - m_plotBounds.yMin) / m_windowHeight);
+    double dx(quantizePixelSize(windowDx * m_resolutionDivisor, m_levelX));
+    double dy(quantizePixelSize(windowDy * m_resolutionDivisor, m_levelY));
+
+    m_gridX = llround(m_plotBounds.xMin / dx);
+    m_gridY = llround(m_plotBounds.yMin / dy);
 
-    int index = (x + y * m_windowWidth) * 4;
+    // The window stretches and shifts the frame by what the grid is off from the bounds
+    m_scale = sf::Vector2f((float)(dx / windowDx), (float)(dy / windowDy));
+    m_offset = sf::Vector2f((float)(((double)m_gridX * dx - m_plotBounds.xMin) / windowDx), (float)(((double)m_gridY * dy - m_plotBounds.yMin) / windowDy));
 
-    m_data->pixels[index] = color.r;
-    m_data->pixels[index + 1] = color.g;
-    m_data->pixels[index + 2] = color.b;
-    m_data->pixels[index + 3] = color.a;
+    // One more pixel covers the shift and the rounding of the scale
+    m_renderWidth = (unsigned int)ceil(m_windowWidth / m_scale.x) + 1;
+    m_renderHeight = (unsigned int)ceil(m_windowHeight / m_scale.y) + 1;
 
-    m_data->mutex.unlock();
+    // Same mapping as screenToWorld(), without a division per pixel
+    m_affine.x0 = (float)((double)m_gridX * dx);
+    m_affine.dx = (float)dx;
+    m_affine.y0 = (float)((double)m_gridY * dy);
+    m_affine.dy = (float)dy;
+}
+
+double PlotBase::quantizePixelSize(double size, int& level)
+{
+    level = (int)llround(log2(size) * CACHE_SCALE_STEPS);
+
+    return exp2((double)level / CACHE_SCALE_STEPS);
+}
+
+void PlotBase::resizePixelData()
+{
+    // Only the compute thread touches the back frame, never while the workers are writing
+    m_frame->resize(m_renderWidth, m_renderHeight);
+    alignFrame(*m_frame);
+    m_frame->fill(BACKGROUND_COLOR);
+    m_data->frameBuffer.markAllDirty();
+}
+
+SimdLevel PlotBase::getSimdLevel() const
+{
+    return m_simdLevel;
+}
+
+unsigned long long PlotBase::getGeneration() const
+{
+    return m_generation;
+}
+
+unsigned int PlotBase::getThreadCount() const
+{
+    return m_pool.getThreadCount();
+}
+
+void PlotBase::setCacheBudget(std::size_t bytes)
+{
+    m_cache.setBudget(bytes);
+}
+
+void PlotBase::invalidate()
+{
+    // Nothing computed so far can be trusted, not even for a preview
+    m_cache.clear();
+    m_pending.clear();
+    m_frameValid = false;
+}
+
+void PlotBase::setAdaptiveSampling(const AdaptiveSampling& settings)
+{
+    m_adaptive = settings;
+    m_adaptive.depth = std::min(m_adaptive.depth, (unsigned int)ADAPTIVE_MAX_DEPTH);
+
+    // Pixels computed with the previous settings are not what these would give
+    invalidate();
+}
+
+const AdaptiveSampling& PlotBase::getAdaptiveSampling() const
+{
+    return m_adaptive;
 }
 
-sf::Vector2f Plot::screenToWorld(sf::Vector2i pos)
+sf::Vector2f PlotBase::screenToWorld(sf::Vector2i pos)
 {
     return screenToWorld(pos.x, pos.y);
 }
 
-sf::Vector2f Plot::screenToWorld(int x, int y)
+sf::Vector2f PlotBase::screenToWorld(int x, int y)
 {
     sf::Vector2f coord;
     float xSpan(m_plotBounds.xMax - m_plotBounds.xMin);
@@ -96,12 +707,12 @@ sf::Vector2f Plot::screenToWorld(int x, int y)
     return coord;
 }
 
-sf::Vector2i Plot::worldToScreen(sf::Vector2f pos)
+sf::Vector2i PlotBase::worldToScreen(sf::Vector2f pos)
 {
     return worldToScreen(pos.x, pos.y);
 }
 
-sf::Vector2i Plot::worldToScreen(float x, float y)
+sf::Vector2i PlotBase::worldToScreen(float x, float y)
 {
     sf::Vector2i pos;
 
@@ -111,7 +722,7 @@ sf::Vector2i Plot::worldToScreen(float x, float y)
     return pos;
 }
 
-float Plot::lerp(float rangeMin, float rangeMax, float x)
+float PlotBase::lerp(float rangeMin, float rangeMax, float x)
 {
     return (x - rangeMin) / (rangeMax - rangeMin);
 }
@@ -1,28 +1,683 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include "animationExporter.h"
 #include "sharedData.h"
+#include "threadPool.h"
+#include "kernels.h"
+#include "renderFarm.h"
+#include "tileCache.h"
+
+// Compute tiles are the frame's storage tiles, a tile is written to contiguous memory
+#define TILE_SIZE FRAME_TILE_SIZE
+#define TILES_PER_WAVE 4
+
+// Pixel sizes are rounded to one of this many levels per octave, so a view that comes back finds the same pixels
+#define CACHE_SCALE_STEPS 256
+
+// While the camera moves, the render resolution is divided (up to RESOLUTION_MAX_DIVISOR) to fit a frame in the budget
+#define RESOLUTION_FRAME_BUDGET (1.f / FPS_TARGET)
+#define RESOLUTION_MAX_DIVISOR 8
+
+// Rows computed (and held in memory) at once by render(), two stripes are alive while the previous one is written
+#define BATCH_STRIPE_HEIGHT TILE_SIZE
+
+// Coarsest level of the progressive refinement: one sample per 16x16 block, then 8x8, ... down to 1x1
+#define PROGRESSIVE_MAX_STEP 16
+
+// Adaptive sampling: cells of 2^depth pixels, split while their corners differ by more than the threshold on any channel (0-255)
+#define ADAPTIVE_DEFAULT_DEPTH 3
+#define ADAPTIVE_DEFAULT_THRESHOLD 8.f
+#define ADAPTIVE_MAX_DEPTH 6
+
+// Samples of a block along one side: a block starting anywhere in a cell, up to a tile wide, plus the far corner
+#define ADAPTIVE_GRID_SIZE (2 * TILE_SIZE + 1)
+
+/*
+- PlotBase holds everything that does not depend on the kernel: settings, frame, thread pool, tile waves
+- Only the pending regions of the back frame are computed: after a pan, the pixels are scrolled and the exposed strips added
+- After a zoom, the previous frame is resampled and published at once, then refined tile by tile from the center
+- Other regions are refined coarse to fine, each level is published as a complete (blocky) image
+- While the camera moves, the resolution is lowered from the measured cost per pixel, full resolution comes back once idle
+- Frame pixels sit on a world grid (quantized pixel size, origin on a whole pixel), the window makes up for the difference
+- The frame's storage tiles are the world tiles, so a tile is computed, cached and scrolled as one block of memory
+- Finished world tiles are kept in an LRU cache and reused when the view comes back, call invalidate() after changing the kernel
+- render() computes any bounds at any size without a window, in stripes streamed to an image file
+- renderWorker() computes the tiles of such an image for a RenderCoordinator, possibly in another process (see renderFarm.h),
+  getFarmIdentity() tells the coordinator which workers render the same pixels as this plot
+- renderAnimation() exports the frames of a camera path as raw RGBA, reusing the pixels consecutive frames share (see animationExporter.h)
+- Plot<Kernel> only adds the tile loop, so the kernel is inlined in it (see kernels.h for the kernel interface)
+- Adaptive sampling (off by default) samples quadtree cell corners and only splits cells whose corners differ,
+  it replaces the progressive levels and is used by render() as well
+*/
+
+enum class AdaptiveFill { SOLID = 0, INTERPOLATE };
 
-class Plot
+struct AdaptiveSampling
+{
+	unsigned int depth = 0;		// Cells start at 2^depth pixels, 0 computes every pixel
+	float threshold = ADAPTIVE_DEFAULT_THRESHOLD;
+	AdaptiveFill fill = AdaptiveFill::INTERPOLATE;	// How a cell with close corners is filled
+};
+
+struct PendingRegion
+{
+	sf::IntRect rect;
+	unsigned int step = 0;		// Finest level already sampled, 0 when nothing was
+	bool preview = false;		// Already shows a resampled preview
+};
+
+class PlotBase
 {
 	public:
-		Plot(SharedData *data);
+		PlotBase(SharedData *data, unsigned int threadCount = 0);
+		~PlotBase();
 
-		void compute();
 		void updatePlotSettings();
 
-	private:
-		void initData();
-		void setPixelColor(unsigned int x, unsigned int y, sf::Color color);
+		SimdLevel getSimdLevel() const;
+		unsigned int getThreadCount() const;
+		unsigned long long getGeneration() const;
 
 		sf::Vector2f screenToWorld(sf::Vector2i pos);
 		sf::Vector2f screenToWorld(int x, int y);
 		sf::Vector2i worldToScreen(sf::Vector2f pos);
 		sf::Vector2i worldToScreen(float x, float y);
 
-		static float lerp(float rangeMin, float rangeMax, float x);
+		void setCacheBudget(std::size_t bytes);
+		void invalidate();
+
+		void setAdaptiveSampling(const AdaptiveSampling& settings);
+		const AdaptiveSampling& getAdaptiveSampling() const;
+
+	protected:
+		void computeTiles(const std::function<void(const PendingRegion&, unsigned int)>& computeTile);
+		// Computes a block whose first pixel is pixel (gridX, gridY) of the image, so that adaptive cells line up across blocks
+		typedef std::function<void(const Affine&, long long, long long, unsigned int, unsigned int, sf::Color*, unsigned int)> BlockFunction;
+
+		bool renderStripes(const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height, const BlockFunction& renderBlock);
+		void renderArea(const Bounds& bounds, unsigned int width, unsigned int height, const sf::IntRect& area, sf::Color* pixels, unsigned int stride,
+			const BlockFunction& renderBlock);
+		void renderArea(double xMin, double yMin, double dx, double dy, const sf::IntRect& area, sf::Color* pixels, unsigned int stride,
+			const BlockFunction& renderBlock, long long gridX = 0, long long gridY = 0);
+		// Kernel type and hash of what else the pixels depend on: the kernel's identity and the sampling settings
+		std::string farmIdentity(const char* kernelType, const std::string& kernelIdentity) const;
 
 		SharedData *m_data;
+		Frame *m_frame;
 		Bounds m_plotBounds;
+		Affine m_affine;
 		unsigned int m_windowWidth;
 		unsigned int m_windowHeight;
+		unsigned int m_renderWidth;
+		unsigned int m_renderHeight;
+		long long m_gridX;		// World grid position of the first frame pixel
+		long long m_gridY;
+
+		SimdLevel m_simdLevel;
+		AdaptiveSampling m_adaptive;
+		bool m_progressive;		// Coarse levels before the full resolution, not for block kernels
+
+	private:
+		void initData();
+		void resizePixelData();
+		void publish();
+		bool tileCancelled();
+
+		void measurePixelCost(float seconds, unsigned int pixels);
+		void chooseResolution();
+
+		void reuseFrame();
+		void alignFrame(Frame& frame) const;
+		void scrollFrame(int offsetX, int offsetY);
+		void previewFrame(const Affine& from, const Affine& to);
+		bool isTranslation(int& offsetX, int& offsetY) const;
+		unsigned int nextStep(const PendingRegion& region) const;
+		static int distanceSquared(const sf::IntRect& rect, sf::Vector2i point);
+		void splitIntoTiles(const PendingRegion& region, std::vector<PendingRegion>& tiles) const;
+
+		TileKey tileKey(int x, int y) const;
+		void fetchCachedTiles(std::vector<PendingRegion>& tiles);
+		void storeCachedTiles();
+		static double quantizePixelSize(double size, int& level);
+
+		static float lerp(float rangeMin, float rangeMax, float x);
+
+		int m_levelX;
+		int m_levelY;
+		sf::Vector2f m_scale;
+		sf::Vector2f m_offset;
+
+		Affine m_frameAffine;
+		long long m_frameGridX;
+		long long m_frameGridY;
+		int m_frameLevelX;
+		int m_frameLevelY;
+		bool m_frameValid;
+		Frame m_preview;
+
+		unsigned long long m_generation;		// Of the camera being rendered
+		bool m_interacting;
+		unsigned int m_resolutionDivisor;
+		float m_pixelCost;
+		std::vector<PendingRegion> m_pending;
+		TileCache m_cache;
+
+		ThreadPool m_pool;
+		std::atomic<bool> m_cancelled;
+};
+
+template <class Kernel>
+class Plot : public PlotBase
+{
+	public:
+		typedef typename Kernel::Output Output;
+
+		Plot(SharedData *data, const Kernel& kernel = Kernel(), unsigned int threadCount = 0);
+
+		void compute();
+		bool render(const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height);
+		bool renderWorker(const std::string& host, unsigned short port);
+		std::string getFarmIdentity() const;
+		bool renderAnimation(const std::string& path, const CameraPath& camera, unsigned int width, unsigned int height, unsigned int frameCount);
+
+		Kernel& kernel();
+
+	private:
+		typedef void (Kernel::*RowFunction)(const PixelRow& row, Output* out) const;
+
+		struct Cell
+		{
+			int x;		// Top left corner, in samples of the block
+			int y;
+		};
+
+		void computeTile(const PendingRegion& tile, unsigned int step);
+		void computeRowTile(const PendingRegion& tile, unsigned int step, const Affine& origin);
+		void renderImageBlock(const Affine& origin, long long gridX, long long gridY, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride);
+		void renderBlock(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride);
+		void renderAdaptive(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride, unsigned int phaseX, unsigned int phaseY);
+		void fillCell(const Cell& cell, int size, const sf::Color* samples, int columns, int phaseX, int phaseY, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const;
+		void computeSamples(const PendingRegion& tile, unsigned int step);
+		void evaluateRow(const PixelRow& row, Output* out) const;
+		RowFunction selectRowFunction() const;
+
+		Kernel m_kernel;
+		RowFunction m_rowFunction;
 };
+
+// Kernel interface detection, a missing wide row function falls back to the next narrower one
+#define PLOT_DETECT_ROW_FUNCTION(traitName, function) \
+	template <class Kernel, class = void> struct traitName : std::false_type {}; \
+	template <class Kernel> struct traitName<Kernel, decltype(std::declval<const Kernel&>().function(std::declval<const PixelRow&>(), std::declval<typename Kernel::Output*>()))> : std::true_type {};
+
+PLOT_DETECT_ROW_FUNCTION(HasRow, row)
+PLOT_DETECT_ROW_FUNCTION(HasRowSse2, rowSse2)
+PLOT_DETECT_ROW_FUNCTION(HasRowAvx2, rowAvx2)
+PLOT_DETECT_ROW_FUNCTION(HasRowAvx512, rowAvx512)
+
+#undef PLOT_DETECT_ROW_FUNCTION
+
+// Block kernels compute a whole tile at once, see kernels.h
+template <class Kernel, class = void> struct HasBlock : std::false_type {};
+template <class Kernel> struct HasBlock<Kernel, decltype(std::declval<const Kernel&>().block(std::declval<const Affine&>(), 0u, 0u, std::declval<sf::Color*>(), 0u))> : std::true_type {};
+
+// Kernels with options or a data source tell them apart with identity(), see kernels.h
+template <class Kernel, class = std::string> struct HasIdentity : std::false_type {};
+template <class Kernel> struct HasIdentity<Kernel, decltype(std::declval<const Kernel&>().identity())> : std::true_type {};
+
+template <class Kernel>
+Plot<Kernel>::Plot(SharedData *data, const Kernel& kernel, unsigned int threadCount) : PlotBase(data, threadCount), m_kernel(kernel)
+{
+	m_rowFunction = selectRowFunction();
+	m_progressive = !HasBlock<Kernel>::value;
+}
+
+template <class Kernel>
+void Plot<Kernel>::compute()
+{
+	TraceSpan span(m_data->trace, "compute");
+
+	updatePlotSettings();
+
+	computeTiles([this](const PendingRegion& tile, unsigned int step)
+	{
+		computeTile(tile, step);
+	});
+}
+
+template <class Kernel>
+bool Plot<Kernel>::render(const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height)
+{
+	return renderStripes(path, bounds, width, height, [this](const Affine& origin, long long gridX, long long gridY, unsigned int blockWidth, unsigned int blockHeight,
+		sf::Color* pixels, unsigned int stride)
+	{
+		renderImageBlock(origin, gridX, gridY, blockWidth, blockHeight, pixels, stride);
+	});
+}
+
+template <class Kernel>
+bool Plot<Kernel>::renderWorker(const std::string& host, unsigned short port)
+{
+	RenderWorker worker;
+
+	return worker.run(host, port, getFarmIdentity(), [this](const Bounds& bounds, unsigned int width, unsigned int height, const sf::IntRect& area, sf::Color* pixels, unsigned int stride)
+	{
+		renderArea(bounds, width, height, area, pixels, stride, [this](const Affine& origin, long long gridX, long long gridY, unsigned int blockWidth, unsigned int blockHeight,
+			sf::Color* blockPixels, unsigned int blockStride)
+		{
+			renderImageBlock(origin, gridX, gridY, blockWidth, blockHeight, blockPixels, blockStride);
+		});
+	});
+}
+
+template <class Kernel>
+std::string Plot<Kernel>::getFarmIdentity() const
+{
+	if constexpr (HasIdentity<Kernel>::value)
+		return farmIdentity(typeid(Kernel).name(), m_kernel.identity());
+	else
+		return farmIdentity(typeid(Kernel).name(), std::string());
+}
+
+template <class Kernel>
+Kernel& Plot<Kernel>::kernel()
+{
+	return m_kernel;
+}
+
+template <class Kernel>
+void Plot<Kernel>::computeTile(const PendingRegion& tile, unsigned int step)
+{
+	static_assert(sizeof(sf::Color) == 4, "sf::Color must match the RGBA layout of the frame");
+
+	const sf::IntRect& rect(tile.rect);
+	Affine origin(m_affine);
+
+	origin.x0 += (float)rect.left * m_affine.dx;
+	origin.y0 += (float)rect.top * m_affine.dy;
+
+	if constexpr (HasBlock<Kernel>::value)
+	{
+		renderBlock(origin, (unsigned int)rect.width, (unsigned int)rect.height, m_frame->pixelAt((unsigned int)rect.left, (unsigned int)rect.top), TILE_SIZE);
+	}
+	else
+	{
+		computeRowTile(tile, step, origin);
+	}
+}
+
+template <class Kernel>
+void Plot<Kernel>::computeRowTile(const PendingRegion& tile, unsigned int step, const Affine& origin)
+{
+	bool adaptive(m_adaptive.depth > 0 && step == 1);
+
+	if (!adaptive && (step > 1 || tile.step != 0))
+	{
+		computeSamples(tile, step);
+		return;
+	}
+
+	const sf::IntRect& rect(tile.rect);
+
+	// Cells on the world grid, like the progressive samples: a tile cut by a scroll gets the same pixels
+	if (adaptive)
+	{
+		long long cellSize(1LL << m_adaptive.depth);
+		unsigned int phaseX((unsigned int)(((m_gridX + rect.left) % cellSize + cellSize) % cellSize));
+		unsigned int phaseY((unsigned int)(((m_gridY + rect.top) % cellSize + cellSize) % cellSize));
+
+		renderAdaptive(origin, (unsigned int)rect.width, (unsigned int)rect.height, m_frame->pixelAt((unsigned int)rect.left, (unsigned int)rect.top), TILE_SIZE, phaseX, phaseY);
+		return;
+	}
+
+	renderBlock(origin, (unsigned int)rect.width, (unsigned int)rect.height, m_frame->pixelAt((unsigned int)rect.left, (unsigned int)rect.top), TILE_SIZE);
+}
+
+template <class Kernel>
+bool Plot<Kernel>::renderAnimation(const std::string& path, const CameraPath& camera, unsigned int width, unsigned int height, unsigned int frameCount)
+{
+	AnimationExporter exporter;
+
+	return exporter.run(path, camera, width, height, frameCount, [this](double xMin, double yMin, double dx, double dy, long long frameX, long long frameY,
+		const sf::IntRect& area, sf::Color* pixels, unsigned int stride)
+	{
+		renderArea(xMin, yMin, dx, dy, area, pixels, stride, [this](const Affine& origin, long long gridX, long long gridY, unsigned int blockWidth, unsigned int blockHeight,
+			sf::Color* blockPixels, unsigned int blockStride)
+		{
+			renderImageBlock(origin, gridX, gridY, blockWidth, blockHeight, blockPixels, blockStride);
+		}, frameX, frameY);
+	});
+}
+
+template <class Kernel>
+void Plot<Kernel>::renderImageBlock(const Affine& origin, long long gridX, long long gridY, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride)
+{
+	// Cells on the image grid, wherever the block starts: a strip exposed by an animation frame meets the pixels it reused
+	if constexpr (!HasBlock<Kernel>::value)
+	{
+		if (m_adaptive.depth > 0)
+		{
+			long long cellSize(1LL << m_adaptive.depth);
+			unsigned int phaseX((unsigned int)((gridX % cellSize + cellSize) % cellSize));
+			unsigned int phaseY((unsigned int)((gridY % cellSize + cellSize) % cellSize));
+
+			renderAdaptive(origin, width, height, pixels, stride, phaseX, phaseY);
+			return;
+		}
+	}
+
+	renderBlock(origin, width, height, pixels, stride);
+}
+
+template <class Kernel>
+void Plot<Kernel>::renderBlock(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride)
+{
+	if constexpr (HasBlock<Kernel>::value)
+	{
+		m_kernel.block(origin, width, height, pixels, stride);
+	}
+	else
+	{
+		// One coordinate row (and output row for non color kernels) per worker, reused by every block it computes
+		alignas(SIMD_ALIGNMENT) static thread_local float xCoords[TILE_SIZE + SIMD_MAX_WIDTH];
+		alignas(SIMD_ALIGNMENT) static thread_local Output outputs[TILE_SIZE + SIMD_MAX_WIDTH];
+
+		PixelRow row;
+		row.x = xCoords;
+		row.count = width;
+
+		Simd::fillCoordinates(m_simdLevel, xCoords, origin.x0, origin.dx, row.count);
+
+		for (unsigned int y(0); y < height; y++)
+		{
+			sf::Color* out(pixels + y * stride);
+
+			row.y = origin.y0 + (float)y * origin.dy;
+
+			if constexpr (std::is_same<Output, sf::Color>::value)
+			{
+				evaluateRow(row, out);
+			}
+			else
+			{
+				evaluateRow(row, outputs);
+
+				for (unsigned int i(0); i < row.count; i++)
+					out[i] = m_kernel.toColor(outputs[i]);
+			}
+		}
+	}
+}
+
+template <class Kernel>
+void Plot<Kernel>::renderAdaptive(const Affine& origin, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride, unsigned int phaseX, unsigned int phaseY)
+{
+	// Sample (i, j) is at pixel (i - phaseX, j - phaseY) of the block, cells of the first level start on samples multiple of their size
+	static thread_local sf::Color samples[ADAPTIVE_GRID_SIZE * ADAPTIVE_GRID_SIZE];
+	static thread_local bool sampled[ADAPTIVE_GRID_SIZE * ADAPTIVE_GRID_SIZE];
+	static thread_local std::vector<Cell> cells, splitCells;
+	static thread_local std::vector<int> requests;
+
+	alignas(SIMD_ALIGNMENT) static thread_local float xCoords[ADAPTIVE_GRID_SIZE + SIMD_MAX_WIDTH];
+	alignas(SIMD_ALIGNMENT) static thread_local Output outputs[ADAPTIVE_GRID_SIZE + SIMD_MAX_WIDTH];
+
+	int firstSize(1 << std::min(m_adaptive.depth, (unsigned int)ADAPTIVE_MAX_DEPTH));
+	int columns((((int)(phaseX + width) + firstSize - 1) / firstSize) * firstSize + 1);
+	int rows((((int)(phaseY + height) + firstSize - 1) / firstSize) * firstSize + 1);
+
+	if (columns > ADAPTIVE_GRID_SIZE || rows > ADAPTIVE_GRID_SIZE)
+	{
+		renderBlock(origin, width, height, pixels, stride);
+		return;
+	}
+
+	std::fill(sampled, sampled + columns * rows, false);
+
+	cells.clear();
+	for (int y(0); y + 1 < rows; y += firstSize)
+	{
+		for (int x(0); x + 1 < columns; x += firstSize)
+			cells.push_back({ x, y });
+	}
+
+	PixelRow row;
+	row.x = xCoords;
+
+	for (int size(firstSize); !cells.empty(); size /= 2)
+	{
+		// The corners no cell has sampled yet (only the top left one for single pixels), evaluated a row at a time
+		requests.clear();
+		for (unsigned int i(0); i < cells.size(); i++)
+		{
+			int corners(size > 1 ? 4 : 1);
+
+			for (int corner(0); corner < corners; corner++)
+			{
+				int index(cells[i].x + (corner & 1) * size + (cells[i].y + (corner >> 1) * size) * columns);
+
+				if (!sampled[index])
+				{
+					sampled[index] = true;
+					requests.push_back(index);
+				}
+			}
+		}
+
+		std::sort(requests.begin(), requests.end());
+
+		for (unsigned int first(0); first < requests.size();)
+		{
+			int sampleRow(requests[first] / columns);
+			unsigned int last(first);
+
+			row.count = 0;
+			for (; last < requests.size() && requests[last] / columns == sampleRow; last++)
+				xCoords[row.count++] = origin.x0 + (float)(requests[last] % columns - (int)phaseX) * origin.dx;
+
+			row.y = origin.y0 + (float)(sampleRow - (int)phaseY) * origin.dy;
+			evaluateRow(row, outputs);
+
+			for (unsigned int i(0); i < row.count; i++)
+			{
+				if constexpr (std::is_same<Output, sf::Color>::value)
+					samples[requests[first + i]] = outputs[i];
+				else
+					samples[requests[first + i]] = m_kernel.toColor(outputs[i]);
+			}
+
+			first = last;
+		}
+
+		// Cells with close corners are filled, the others split in four, skipping the quarters outside the block
+		splitCells.clear();
+		for (unsigned int i(0); i < cells.size(); i++)
+		{
+			const Cell& cell(cells[i]);
+			bool flat(true);
+
+			if (size > 1)
+			{
+				const sf::Color* corner(samples + cell.x + cell.y * columns);
+				const sf::Color corners[4] = { corner[0], corner[size], corner[size * columns], corner[size + size * columns] };
+
+				for (unsigned int c(1); c < 4 && flat; c++)
+				{
+					flat = std::abs((int)corners[c].r - (int)corners[0].r) <= m_adaptive.threshold
+						&& std::abs((int)corners[c].g - (int)corners[0].g) <= m_adaptive.threshold
+						&& std::abs((int)corners[c].b - (int)corners[0].b) <= m_adaptive.threshold
+						&& std::abs((int)corners[c].a - (int)corners[0].a) <= m_adaptive.threshold;
+				}
+			}
+
+			if (flat)
+			{
+				fillCell(cell, size, samples, columns, (int)phaseX, (int)phaseY, width, height, pixels, stride);
+				continue;
+			}
+
+			int half(size / 2);
+
+			for (int quarter(0); quarter < 4; quarter++)
+			{
+				Cell child = { cell.x + (quarter & 1) * half, cell.y + (quarter >> 1) * half };
+				int left(child.x - (int)phaseX), top(child.y - (int)phaseY);
+
+				if (left + half > 0 && top + half > 0 && left < (int)width && top < (int)height)
+					splitCells.push_back(child);
+			}
+		}
+
+		std::swap(cells, splitCells);
+	}
+}
+
+template <class Kernel>
+void Plot<Kernel>::fillCell(const Cell& cell, int size, const sf::Color* samples, int columns, int phaseX, int phaseY, unsigned int width, unsigned int height, sf::Color* pixels, unsigned int stride) const
+{
+	// Part of the cell inside the block, in pixels of the block
+	int left(std::max(cell.x - phaseX, 0)), right(std::min(cell.x - phaseX + size, (int)width));
+	int top(std::max(cell.y - phaseY, 0)), bottom(std::min(cell.y - phaseY + size, (int)height));
+
+	const sf::Color* corner(samples + cell.x + cell.y * columns);
+
+	if (size == 1 || m_adaptive.fill == AdaptiveFill::SOLID)
+	{
+		for (int y(top); y < bottom; y++)
+			std::fill(pixels + left + y * (int)stride, pixels + right + y * (int)stride, corner[0]);
+
+		return;
+	}
+
+	// Bilinear between the four corners
+	const sf::Color& c00(corner[0]);
+	const sf::Color& c10(corner[size]);
+	const sf::Color& c01(corner[size * columns]);
+	const sf::Color& c11(corner[size + size * columns]);
+	float inverse(1.f / (float)size);
+
+	for (int y(top); y < bottom; y++)
+	{
+		float v((float)(y + phaseY - cell.y) * inverse);
+		sf::Color* out(pixels + y * (int)stride);
+
+		for (int x(left); x < right; x++)
+		{
+			float u((float)(x + phaseX - cell.x) * inverse);
+			float w00((1.f - u) * (1.f - v)), w10(u * (1.f - v)), w01((1.f - u) * v), w11(u * v);
+
+			out[x] = sf::Color(
+				(sf::Uint8)(w00 * c00.r + w10 * c10.r + w01 * c01.r + w11 * c11.r + 0.5f),
+				(sf::Uint8)(w00 * c00.g + w10 * c10.g + w01 * c01.g + w11 * c11.g + 0.5f),
+				(sf::Uint8)(w00 * c00.b + w10 * c10.b + w01 * c01.b + w11 * c11.b + 0.5f),
+				(sf::Uint8)(w00 * c00.a + w10 * c10.a + w01 * c01.a + w11 * c11.a + 0.5f));
+		}
+	}
+}
+
+template <class Kernel>
+void Plot<Kernel>::computeSamples(const PendingRegion& tile, unsigned int step)
+{
+	alignas(SIMD_ALIGNMENT) static thread_local float xCoords[TILE_SIZE + SIMD_MAX_WIDTH];
+	alignas(SIMD_ALIGNMENT) static thread_local Output outputs[TILE_SIZE + SIMD_MAX_WIDTH];
+
+	const sf::IntRect& rect(tile.rect);
+	bool refining(tile.step == 2 * step);
+	int size((int)step);
+	int right(rect.left + rect.width), bottom(rect.top + rect.height);
+
+	// The sample lattice is anchored to the world grid, blocks straddling tiles (or cut by a scroll) get the same sample
+	int blockLeft(rect.left - (int)(((m_gridX + rect.left) % size + size) % size));
+	int blockTop(rect.top - (int)(((m_gridY + rect.top) % size + size) % size));
+
+	PixelRow row;
+	row.x = xCoords;
+
+	// One sample per step x step block, at its top left corner, filling the part of the block inside the tile
+	for (int sy(blockTop); sy < bottom; sy += size)
+	{
+		// Rows already sampled by the previous level only miss every other column
+		bool sampledRow(refining && ((m_gridY + sy) % (2 * size) + 2 * size) % (2 * size) == 0);
+		int first(blockLeft);
+		int stride(sampledRow ? 2 * size : size);
+
+		if (sampledRow && ((m_gridX + first) % stride + stride) % stride == 0)
+			first += size;
+
+		if (first >= right)
+			continue;
+
+		row.count = (unsigned int)((right - first + stride - 1) / stride);
+		row.y = m_affine.y0 + (float)sy * m_affine.dy;
+
+		Simd::fillCoordinates(m_simdLevel, xCoords, m_affine.x0 + (float)first * m_affine.dx, (float)stride * m_affine.dx, row.count);
+		evaluateRow(row, outputs);
+
+		int top(std::max(sy, rect.top)), blockBottom(std::min(sy + size, bottom));
+
+		for (unsigned int i(0); i < row.count; i++)
+		{
+			int sx(first + (int)i * stride);
+			int left(std::max(sx, rect.left)), blockRight(std::min(sx + size, right));
+			sf::Color color;
+
+			if constexpr (std::is_same<Output, sf::Color>::value)
+				color = outputs[i];
+			else
+				color = m_kernel.toColor(outputs[i]);
+
+			for (int y(top); y < blockBottom; y++)
+			{
+				sf::Color* pixels(m_frame->pixelAt((unsigned int)left, (unsigned int)y));
+				std::fill(pixels, pixels + (blockRight - left), color);
+			}
+		}
+	}
+}
+
+template <class Kernel>
+void Plot<Kernel>::evaluateRow(const PixelRow& row, Output* out) const
+{
+	if constexpr (HasRow<Kernel>::value)
+	{
+		(m_kernel.*m_rowFunction)(row, out);
+	}
+	else
+	{
+		for (unsigned int i(0); i < row.count; i++)
+			out[i] = m_kernel(row.x[i], row.y);
+	}
+}
+
+template <class Kernel>
+typename Plot<Kernel>::RowFunction Plot<Kernel>::selectRowFunction() const
+{
+	if constexpr (HasRow<Kernel>::value)
+	{
+#ifdef SIMD_X86
+		if constexpr (HasRowAvx512<Kernel>::value)
+			if (m_simdLevel >= SimdLevel::AVX512)
+				return &Kernel::rowAvx512;
+
+		if constexpr (HasRowAvx2<Kernel>::value)
+			if (m_simdLevel >= SimdLevel::AVX2)
+				return &Kernel::rowAvx2;
+
+		if constexpr (HasRowSse2<Kernel>::value)
+			if (m_simdLevel >= SimdLevel::SSE2)
+				return &Kernel::rowSse2;
+#endif
+
+		return &Kernel::row;
+	}
+	else
+	{
+		return nullptr;
+	}
+}
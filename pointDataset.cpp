@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#include "pointDataset.h"
+#include "threadPool.h"
+
+static const char POINT_INDEX_MAGIC[8] = { 'P', 'T', 'I', 'N', 'D', 'E', 'X', '\0' };
+
+PointDataset::PointDataset()
+{
+	m_offsets = nullptr;
+	m_records = nullptr;
+	m_pointCount = 0;
+
+	setGrid({ 0.f, 1.f, 0.f, 1.f }, 1);
+}
+
+bool PointDataset::open(const std::string& path)
+{
+	close();
+
+	std::error_code error;
+	std::uint64_t sourceSize(std::filesystem::file_size(path, error));
+
+	if (error)
+		return false;
+
+	std::int64_t sourceTime((std::int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count());
+
+	if (error)
+		return false;
+
+	std::string indexPath(path + POINT_INDEX_EXTENSION);
+
+	if (loadIndex(indexPath, sourceSize, sourceTime))
+		return true;
+
+	return buildIndex(path, indexPath, sourceSize, sourceTime) && loadIndex(indexPath, sourceSize, sourceTime);
+}
+
+void PointDataset::close()
+{
+	m_index.close();
+
+	m_offsets = nullptr;
+	m_records = nullptr;
+	m_pointCount = 0;
+
+	setGrid({ 0.f, 1.f, 0.f, 1.f }, 1);
+}
+
+std::uint64_t PointDataset::getPointCount() const
+{
+	return m_pointCount;
+}
+
+const Bounds& PointDataset::getBounds() const
+{
+	return m_bounds;
+}
+
+unsigned int PointDataset::getGridSize() const
+{
+	return m_gridSize;
+}
+
+float PointDataset::getCellWidth() const
+{
+	return (m_bounds.xMax - m_bounds.xMin) / (float)m_gridSize;
+}
+
+float PointDataset::getCellHeight() const
+{
+	return (m_bounds.yMax - m_bounds.yMin) / (float)m_gridSize;
+}
+
+// PRIVATE
+bool PointDataset::loadIndex(const std::string& indexPath, std::uint64_t sourceSize, std::int64_t sourceTime)
+{
+	if (!m_index.open(indexPath) || m_index.size() < POINT_INDEX_HEADER_SIZE)
+	{
+		m_index.close();
+		return false;
+	}
+
+	IndexHeader header;
+	std::memcpy(&header, m_index.data(), sizeof(IndexHeader));
+
+	bool valid(std::memcmp(header.magic, POINT_INDEX_MAGIC, sizeof(POINT_INDEX_MAGIC)) == 0
+		&& header.version == POINT_INDEX_VERSION
+		&& header.gridSize >= 1 && header.gridSize <= POINT_INDEX_MAX_GRID
+		&& header.sourceSize == sourceSize && header.sourceTime == sourceTime
+		&& m_index.size() == indexSize(header.gridSize, header.pointCount));
+
+	if (!valid)
+	{
+		m_index.close();
+		return false;
+	}
+
+	m_offsets = reinterpret_cast<const std::uint64_t*>(m_index.data() + POINT_INDEX_HEADER_SIZE);
+	m_records = reinterpret_cast<const PointRecord*>(m_offsets + (std::uint64_t)header.gridSize * header.gridSize + 1);
+	m_pointCount = header.pointCount;
+
+	setGrid(header.bounds, header.gridSize);
+
+	return true;
+}
+
+bool PointDataset::buildIndex(const std::string& path, const std::string& indexPath, std::uint64_t sourceSize, std::int64_t sourceTime)
+{
+	MappedFile source;
+
+	if (!source.open(path))
+		return false;
+
+	const PointRecord* records(reinterpret_cast<const PointRecord*>(source.data()));
+	std::uint64_t recordCount(source.size() / sizeof(PointRecord));
+
+	// Every pass reads the dataset a chunk per task
+	ThreadPool pool;
+	std::uint64_t chunkSize(std::max((std::uint64_t)POINT_INDEX_CHUNK_RECORDS, (recordCount + POINT_INDEX_MAX_CHUNKS - 1) / POINT_INDEX_MAX_CHUNKS));
+	unsigned int chunks((unsigned int)((recordCount + chunkSize - 1) / chunkSize));
+
+	// Bounds
+	IndexHeader header = {};
+	std::memcpy(header.magic, POINT_INDEX_MAGIC, sizeof(POINT_INDEX_MAGIC));
+	header.version = POINT_INDEX_VERSION;
+	header.pointCount = 0;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.bounds = { std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+
+	std::vector<Bounds> chunkBounds(chunks, header.bounds);
+	std::vector<std::uint64_t> chunkPoints(chunks, 0);
+
+	pool.parallelFor(chunks, [&](unsigned int chunk)
+	{
+		Bounds& bounds(chunkBounds[chunk]);
+		std::uint64_t end(std::min(recordCount, (chunk + 1) * chunkSize));
+
+		for (std::uint64_t i(chunk * chunkSize); i < end; i++)
+		{
+			const PointRecord& record(records[i]);
+
+			if (!std::isfinite(record.x) || !std::isfinite(record.y))
+				continue;
+
+			bounds.xMin = std::min(bounds.xMin, record.x);
+			bounds.xMax = std::max(bounds.xMax, record.x);
+			bounds.yMin = std::min(bounds.yMin, record.y);
+			bounds.yMax = std::max(bounds.yMax, record.y);
+			chunkPoints[chunk]++;
+		}
+	});
+
+	for (unsigned int chunk(0); chunk < chunks; chunk++)
+	{
+		header.bounds.xMin = std::min(header.bounds.xMin, chunkBounds[chunk].xMin);
+		header.bounds.xMax = std::max(header.bounds.xMax, chunkBounds[chunk].xMax);
+		header.bounds.yMin = std::min(header.bounds.yMin, chunkBounds[chunk].yMin);
+		header.bounds.yMax = std::max(header.bounds.yMax, chunkBounds[chunk].yMax);
+		header.pointCount += chunkPoints[chunk];
+	}
+
+	if (header.pointCount == 0)
+		header.bounds = { 0.f, 1.f, 0.f, 1.f };
+
+	header.gridSize = POINT_INDEX_MIN_GRID;
+	while (header.gridSize < POINT_INDEX_MAX_GRID && (std::uint64_t)header.gridSize * header.gridSize * POINT_INDEX_CELL_POINTS < header.pointCount)
+		header.gridSize *= 2;
+
+	setGrid(header.bounds, header.gridSize);
+
+	unsigned int rows(header.gridSize);
+
+	// Points per chunk and row of cells (chunkRows[chunk * rows + row])
+	std::vector<std::uint64_t> chunkRows((std::size_t)chunks * rows, 0);
+
+	pool.parallelFor(chunks, [&](unsigned int chunk)
+	{
+		std::uint64_t* counts(chunkRows.data() + (std::size_t)chunk * rows);
+		std::uint64_t end(std::min(recordCount, (chunk + 1) * chunkSize));
+
+		for (std::uint64_t i(chunk * chunkSize); i < end; i++)
+		{
+			const PointRecord& record(records[i]);
+
+			if (std::isfinite(record.x) && std::isfinite(record.y))
+				counts[cellY(record.y)]++;
+		}
+	});
+
+	// Where each row starts in the records
+	std::vector<std::uint64_t> rowStarts(rows + 1, 0);
+
+	for (unsigned int row(0); row < rows; row++)
+	{
+		rowStarts[row + 1] = rowStarts[row];
+
+		for (unsigned int chunk(0); chunk < chunks; chunk++)
+			rowStarts[row + 1] += chunkRows[(std::size_t)chunk * rows + row];
+	}
+
+	// Bands of rows of about POINT_INDEX_BAND_BYTES of records, at least a row each
+	std::vector<unsigned int> bandRows(1, 0);
+	std::vector<unsigned int> rowBands(rows);
+
+	for (unsigned int row(0); row < rows; row++)
+	{
+		if (row > bandRows.back() && (rowStarts[row + 1] - rowStarts[bandRows.back()]) * sizeof(PointRecord) > POINT_INDEX_BAND_BYTES)
+			bandRows.push_back(row);
+
+		rowBands[row] = (unsigned int)bandRows.size() - 1;
+	}
+
+	unsigned int bands((unsigned int)bandRows.size());
+	bandRows.push_back(rows);
+
+	// Where the points of each chunk start in each band (chunkBands[chunk * bands + band]), chunk after chunk
+	std::vector<std::uint64_t> chunkBands((std::size_t)chunks * bands);
+
+	for (unsigned int band(0); band < bands; band++)
+	{
+		std::uint64_t start(rowStarts[bandRows[band]]);
+
+		for (unsigned int chunk(0); chunk < chunks; chunk++)
+		{
+			chunkBands[(std::size_t)chunk * bands + band] = start;
+
+			for (unsigned int row(bandRows[band]); row < bandRows[band + 1]; row++)
+				start += chunkRows[(std::size_t)chunk * rows + row];
+		}
+	}
+
+	// From here on, where the points of each chunk start in each row
+	for (unsigned int row(0); row < rows; row++)
+	{
+		std::uint64_t start(rowStarts[row]);
+
+		for (unsigned int chunk(0); chunk < chunks; chunk++)
+		{
+			std::uint64_t count(chunkRows[(std::size_t)chunk * rows + row]);
+			chunkRows[(std::size_t)chunk * rows + row] = start;
+			start += count;
+		}
+	}
+
+	// Written under another name and renamed once complete, an interrupted build never looks like an index
+	std::string buildPath(indexPath + ".tmp");
+	MappedFile index;
+
+	if (!index.create(buildPath, indexSize(header.gridSize, header.pointCount)))
+		return false;
+
+	std::uint64_t cells((std::uint64_t)header.gridSize * header.gridSize);
+	std::uint64_t* offsets(reinterpret_cast<std::uint64_t*>(index.data() + POINT_INDEX_HEADER_SIZE));
+	PointRecord* sorted(reinterpret_cast<PointRecord*>(offsets + cells + 1));
+
+	// The only read of the dataset copying points: each goes to the span of its band, a chunk's points of a band contiguous and
+	// in order, so the index is written in a few sequential streams (points sent anywhere would be written back page by page at random)
+	pool.parallelFor(chunks, [&](unsigned int chunk)
+	{
+		std::vector<std::uint64_t> cursors(chunkBands.begin() + (std::ptrdiff_t)chunk * bands, chunkBands.begin() + (std::ptrdiff_t)(chunk + 1) * bands);
+		std::uint64_t end(std::min(recordCount, (chunk + 1) * chunkSize));
+
+		for (std::uint64_t i(chunk * chunkSize); i < end; i++)
+		{
+			const PointRecord& record(records[i]);
+
+			if (std::isfinite(record.x) && std::isfinite(record.y))
+				sorted[cursors[rowBands[cellY(record.y)]]++] = record;
+		}
+	});
+
+	source.close();
+
+	// Then each band in memory: its points sorted by row (chunk by chunk, keeping the dataset order), then by cell into the index
+	std::uint64_t recordsOffset((std::uint64_t)(reinterpret_cast<std::uint8_t*>(sorted) - index.data()));
+	std::vector<PointRecord> bandPoints;
+	bool written(true);
+
+	for (unsigned int band(0); band < bands && written; band++)
+	{
+		unsigned int firstRow(bandRows[band]);
+		unsigned int lastRow(bandRows[band + 1]);
+		std::uint64_t first(rowStarts[firstRow]);
+		std::uint64_t last(rowStarts[lastRow]);
+
+		bandPoints.resize(last - first);
+
+		pool.parallelFor(chunks, [&](unsigned int chunk)
+		{
+			std::uint64_t begin(chunkBands[(std::size_t)chunk * bands + band]);
+			std::uint64_t end(chunk + 1 < chunks ? chunkBands[(std::size_t)(chunk + 1) * bands + band] : last);
+			std::vector<std::uint64_t> cursors(chunkRows.begin() + (std::ptrdiff_t)((std::size_t)chunk * rows + firstRow), chunkRows.begin() + (std::ptrdiff_t)((std::size_t)chunk * rows + lastRow));
+
+			for (std::uint64_t i(begin); i < end; i++)
+				bandPoints[cursors[cellY(sorted[i].y) - firstRow]++ - first] = sorted[i];
+		});
+
+		pool.parallelFor(lastRow - firstRow, [&](unsigned int i)
+		{
+			unsigned int row(firstRow + i);
+			const PointRecord* points(bandPoints.data() + (rowStarts[row] - first));
+			std::uint64_t count(rowStarts[row + 1] - rowStarts[row]);
+			std::uint64_t* rowOffsets(offsets + (std::uint64_t)row * header.gridSize);
+
+			// Points per cell, then where each cell starts
+			std::vector<std::uint64_t> cursors(header.gridSize, 0);
+
+			for (std::uint64_t point(0); point < count; point++)
+				cursors[cellX(points[point].x)]++;
+
+			std::uint64_t start(rowStarts[row]);
+
+			for (unsigned int cell(0); cell < header.gridSize; cell++)
+			{
+				rowOffsets[cell] = start;
+				start += cursors[cell];
+				cursors[cell] = rowOffsets[cell];
+			}
+
+			for (std::uint64_t point(0); point < count; point++)
+				sorted[cursors[cellX(points[point].x)]++] = points[point];
+		});
+
+		written = index.flush(recordsOffset + first * sizeof(PointRecord), (last - first) * sizeof(PointRecord));
+	}
+
+	offsets[cells] = header.pointCount;
+	std::memcpy(index.data(), &header, sizeof(IndexHeader));
+
+	written = written && index.flush();
+	index.close();
+
+	std::error_code error;
+
+	if (written)
+		std::filesystem::rename(buildPath, indexPath, error);
+
+	if (!written || error)
+	{
+		std::filesystem::remove(buildPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+void PointDataset::setGrid(const Bounds& bounds, unsigned int gridSize)
+{
+	float width(bounds.xMax - bounds.xMin);
+	float height(bounds.yMax - bounds.yMin);
+
+	m_bounds = bounds;
+	m_gridSize = gridSize;
+	m_cellScaleX = width > 0.f ? (float)gridSize / width : 0.f;
+	m_cellScaleY = height > 0.f ? (float)gridSize / height : 0.f;
+}
+
+std::uint64_t PointDataset::indexSize(unsigned int gridSize, std::uint64_t pointCount)
+{
+	static_assert(sizeof(IndexHeader) <= POINT_INDEX_HEADER_SIZE, "The index header must fit POINT_INDEX_HEADER_SIZE");
+	static_assert(sizeof(PointRecord) == 12, "A point record is three packed floats");
+
+	return POINT_INDEX_HEADER_SIZE + ((std::uint64_t)gridSize * gridSize + 1) * sizeof(std::uint64_t) + pointCount * sizeof(PointRecord);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "cameraChannel.h"
+#include "mappedFile.h"
+
+// The index grid is sized for about this many points per cell, within these bounds (powers of two)
+#define POINT_INDEX_CELL_POINTS 16
+#define POINT_INDEX_MIN_GRID 16
+#define POINT_INDEX_MAX_GRID 4096
+
+// The copy pass of the build fills the index a band of cell rows at a time, each band about this many bytes of records (held in memory while written)
+#define POINT_INDEX_BAND_BYTES (512ull << 20)
+
+// The build reads the dataset in chunks of at least this many records, one task each, and no more chunks than this (it counts points per chunk and row of cells)
+#define POINT_INDEX_CHUNK_RECORDS (1ull << 22)
+#define POINT_INDEX_MAX_CHUNKS 1024
+
+// Written next to the dataset, rebuilt when the dataset size or modification time changes
+#define POINT_INDEX_EXTENSION ".index"
+#define POINT_INDEX_VERSION 1
+#define POINT_INDEX_HEADER_SIZE 64
+
+/*
+- A dataset is a flat binary file of PointRecord (three little endian floats, no header), of any size
+- The index is a uniform grid over the bounds of the points, with the points copied sorted by cell:
+  header, then gridSize² + 1 cell offsets (row by row), then the records
+- The points of a row of cells are contiguous, a query reads one span of the file per row of cells
+- Both files are memory mapped, only the pages of the cells looked at are ever read from the disk
+- The index holds a copy of every point, so it takes as much disk space again as the dataset: the price of reading
+  one span per row of cells instead of points scattered over the whole file
+- Building the index, only once, reads the dataset three times in chunks spread over a thread pool: the bounds, the counts
+  per row of cells, then the copy of each point to the span of its band of POINT_INDEX_BAND_BYTES, written as a few sequential streams;
+  each band is then sorted by cell in memory and goes back to the disk in order
+- Points with a non finite coordinate are left out of the index
+*/
+
+struct PointRecord
+{
+	float x;
+	float y;
+	float value;
+};
+
+class PointDataset
+{
+	public:
+		PointDataset();
+
+		bool open(const std::string& path);
+		void close();
+
+		std::uint64_t getPointCount() const;
+		const Bounds& getBounds() const;
+
+		unsigned int getGridSize() const;
+		float getCellWidth() const;
+		float getCellHeight() const;
+
+		// Cell of a coordinate, clamped to the grid: a point lies in the cells of any rectangle around it
+		unsigned int cellX(float x) const { return (unsigned int)std::fmin(std::fmax((x - m_bounds.xMin) * m_cellScaleX, 0.f), (float)(m_gridSize - 1)); }
+		unsigned int cellY(float y) const { return (unsigned int)std::fmin(std::fmax((y - m_bounds.yMin) * m_cellScaleY, 0.f), (float)(m_gridSize - 1)); }
+
+		// Points of cells [cellX, cellX + count) on a row of cells
+		const PointRecord* cellsBegin(unsigned int cellX, unsigned int cellY) const { return m_records + m_offsets[(std::uint64_t)cellY * m_gridSize + cellX]; }
+		const PointRecord* cellsEnd(unsigned int cellX, unsigned int cellY, unsigned int count) const { return m_records + m_offsets[(std::uint64_t)cellY * m_gridSize + cellX + count]; }
+		std::uint64_t cellCount(unsigned int cellX, unsigned int cellY) const
+		{
+			std::uint64_t cell((std::uint64_t)cellY * m_gridSize + cellX);
+
+			return m_offsets[cell + 1] - m_offsets[cell];
+		}
+
+	private:
+		struct IndexHeader
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t gridSize;
+			std::uint64_t pointCount;
+			std::uint64_t sourceSize;		// Of the dataset the index was built from
+			std::int64_t sourceTime;
+			Bounds bounds;
+		};
+
+		bool loadIndex(const std::string& indexPath, std::uint64_t sourceSize, std::int64_t sourceTime);
+		bool buildIndex(const std::string& path, const std::string& indexPath, std::uint64_t sourceSize, std::int64_t sourceTime);
+		void setGrid(const Bounds& bounds, unsigned int gridSize);
+		static std::uint64_t indexSize(unsigned int gridSize, std::uint64_t pointCount);
+
+		MappedFile m_index;
+		const std::uint64_t* m_offsets;
+		const PointRecord* m_records;
+		std::uint64_t m_pointCount;
+
+		Bounds m_bounds;
+		unsigned int m_gridSize;
+		float m_cellScaleX;		// Cells per world unit
+		float m_cellScaleY;
+};
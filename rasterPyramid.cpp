@@ -0,0 +1,290 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <vector>
+
+#include "rasterPyramid.h"
+#include "threadPool.h"
+
+static const char RASTER_PYRAMID_MAGIC[8] = { 'P', 'Y', 'R', 'A', 'M', 'I', 'D', '\0' };
+
+static float* tileData(float* tiles, const RasterPyramid::Level& level, std::uint32_t tileX, std::uint32_t tileY)
+{
+	return tiles + (level.offset - RASTER_PYRAMID_DATA_OFFSET) / sizeof(float) + ((std::uint64_t)tileY * level.tilesX + tileX) * RASTER_TILE_SIZE * RASTER_TILE_SIZE;
+}
+
+RasterPyramid::RasterPyramid()
+{
+	close();
+}
+
+bool RasterPyramid::open(const std::string& path)
+{
+	close();
+
+	if (!m_file.open(path) || m_file.size() < RASTER_PYRAMID_DATA_OFFSET)
+	{
+		close();
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, m_file.data(), sizeof(Header));
+
+	Level levels[RASTER_MAX_LEVELS];
+	std::uint64_t fileSize(0);
+
+	// The level table is only trusted if it is the one these dimensions give
+	bool valid(std::memcmp(header.magic, RASTER_PYRAMID_MAGIC, sizeof(RASTER_PYRAMID_MAGIC)) == 0
+		&& header.version == RASTER_PYRAMID_VERSION
+		&& header.width > 0 && header.height > 0
+		&& makeLevels(header.width, header.height, levels, fileSize) == header.levelCount
+		&& std::memcmp(levels, m_file.data() + RASTER_PYRAMID_TABLE_OFFSET, header.levelCount * sizeof(Level)) == 0
+		&& m_file.size() == fileSize);
+
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+
+	m_header = header;
+	std::memcpy(m_levels, levels, sizeof(m_levels));
+	m_tiles = reinterpret_cast<const float*>(m_file.data() + RASTER_PYRAMID_DATA_OFFSET);
+
+	return true;
+}
+
+void RasterPyramid::close()
+{
+	m_file.close();
+	m_tiles = nullptr;
+
+	std::memset(&m_header, 0, sizeof(Header));
+	std::memset(m_levels, 0, sizeof(m_levels));
+	m_header.bounds = { 0.f, 1.f, 0.f, 1.f };
+}
+
+bool RasterPyramid::build(const std::string& sourcePath, std::uint64_t width, std::uint64_t height, const Bounds& bounds, const std::string& path)
+{
+	MappedFile source;
+
+	if (width == 0 || height == 0 || !source.open(sourcePath) || source.size() < width * height * sizeof(float))
+		return false;
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	std::memcpy(header.magic, RASTER_PYRAMID_MAGIC, sizeof(RASTER_PYRAMID_MAGIC));
+	header.version = RASTER_PYRAMID_VERSION;
+	header.width = width;
+	header.height = height;
+	header.bounds = bounds;
+
+	Level levels[RASTER_MAX_LEVELS];
+	std::uint64_t fileSize(0);
+	header.levelCount = makeLevels(width, height, levels, fileSize);
+
+	// Written under another name and renamed once complete, an interrupted build never looks like a pyramid
+	std::string buildPath(path + ".tmp");
+	MappedFile file;
+
+	if (!file.create(buildPath, fileSize))
+		return false;
+
+	const float* pixels(reinterpret_cast<const float*>(source.data()));
+	float* tiles(reinterpret_cast<float*>(file.data() + RASTER_PYRAMID_DATA_OFFSET));
+	const float padding(std::numeric_limits<float>::quiet_NaN());
+
+	ThreadPool pool;
+
+	// Full resolution: a row of tiles at a time, its source rows are read once and in order
+	std::vector<float> tileMin(levels[0].tilesX), tileMax(levels[0].tilesX);
+	header.valueMin = std::numeric_limits<float>::max();
+	header.valueMax = std::numeric_limits<float>::lowest();
+
+	for (std::uint32_t tileY(0); tileY < levels[0].tilesY; tileY++)
+	{
+		pool.parallelFor(levels[0].tilesX, [&](unsigned int tileX)
+		{
+			float* out(tileData(tiles, levels[0], tileX, tileY));
+			float low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+
+			for (std::uint64_t y(0); y < RASTER_TILE_SIZE; y++)
+			{
+				std::uint64_t row((std::uint64_t)tileY * RASTER_TILE_SIZE + y);
+				std::uint64_t column((std::uint64_t)tileX * RASTER_TILE_SIZE);
+				float* texels(out + y * RASTER_TILE_SIZE);
+
+				for (std::uint64_t x(0); x < RASTER_TILE_SIZE; x++)
+				{
+					float value(row < height && column + x < width ? pixels[row * width + column + x] : padding);
+
+					texels[x] = value;
+
+					if (std::isfinite(value))
+					{
+						low = std::min(low, value);
+						high = std::max(high, value);
+					}
+				}
+			}
+
+			tileMin[tileX] = low;
+			tileMax[tileX] = high;
+		});
+
+		header.valueMin = std::min(header.valueMin, *std::min_element(tileMin.begin(), tileMin.end()));
+		header.valueMax = std::max(header.valueMax, *std::max_element(tileMax.begin(), tileMax.end()));
+
+		std::cout << "\rLevel 0: " << (tileY + 1) * 100 / levels[0].tilesY << "%" << std::flush;
+	}
+
+	if (header.valueMin > header.valueMax)
+	{
+		header.valueMin = 0.f;
+		header.valueMax = 1.f;
+	}
+
+	// Halved levels, each from the previous one: a 2x2 block of texels always sits in a single tile
+	for (unsigned int level(1); level < header.levelCount; level++)
+	{
+		const Level& previous(levels[level - 1]);
+		const Level& current(levels[level]);
+
+		for (std::uint32_t tileY(0); tileY < current.tilesY; tileY++)
+		{
+			pool.parallelFor(current.tilesX, [&](unsigned int tileX)
+			{
+				float* out(tileData(tiles, current, tileX, tileY));
+
+				for (unsigned int y(0); y < RASTER_TILE_SIZE; y++)
+				{
+					std::uint32_t sourceTileY(tileY * 2 + y * 2 / RASTER_TILE_SIZE);
+					unsigned int sourceY(y * 2 % RASTER_TILE_SIZE);
+
+					for (unsigned int x(0); x < RASTER_TILE_SIZE; x++)
+					{
+						std::uint32_t sourceTileX(tileX * 2 + x * 2 / RASTER_TILE_SIZE);
+						unsigned int sourceX(x * 2 % RASTER_TILE_SIZE);
+
+						if (sourceTileX >= previous.tilesX || sourceTileY >= previous.tilesY)
+						{
+							out[y * RASTER_TILE_SIZE + x] = padding;
+							continue;
+						}
+
+						const float* block(tileData(tiles, previous, sourceTileX, sourceTileY) + sourceY * RASTER_TILE_SIZE + sourceX);
+						const float values[4] = { block[0], block[1], block[RASTER_TILE_SIZE], block[RASTER_TILE_SIZE + 1] };
+						float sum(0.f);
+						unsigned int count(0);
+
+						for (unsigned int i(0); i < 4; i++)
+						{
+							if (std::isfinite(values[i]))
+							{
+								sum += values[i];
+								count++;
+							}
+						}
+
+						out[y * RASTER_TILE_SIZE + x] = count > 0 ? sum / (float)count : padding;
+					}
+				}
+			});
+		}
+
+		std::cout << "\rLevel " << level << "/" << header.levelCount - 1 << "   " << std::flush;
+	}
+
+	std::cout << std::endl;
+
+	std::memcpy(file.data(), &header, sizeof(Header));
+	std::memcpy(file.data() + RASTER_PYRAMID_TABLE_OFFSET, levels, header.levelCount * sizeof(Level));
+
+	bool written(file.flush());
+	file.close();
+	source.close();
+
+	std::error_code error;
+
+	if (written)
+		std::filesystem::rename(buildPath, path, error);
+
+	if (!written || error)
+	{
+		std::filesystem::remove(buildPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int RasterPyramid::getLevelCount() const
+{
+	return m_header.levelCount;
+}
+
+const RasterPyramid::Level& RasterPyramid::getLevel(unsigned int level) const
+{
+	return m_levels[level];
+}
+
+const Bounds& RasterPyramid::getBounds() const
+{
+	return m_header.bounds;
+}
+
+float RasterPyramid::getValueMin() const
+{
+	return m_header.valueMin;
+}
+
+float RasterPyramid::getValueMax() const
+{
+	return m_header.valueMax;
+}
+
+float RasterPyramid::getTexelWidth() const
+{
+	return m_header.width > 0 ? (m_header.bounds.xMax - m_header.bounds.xMin) / (float)m_header.width : 1.f;
+}
+
+float RasterPyramid::getTexelHeight() const
+{
+	return m_header.height > 0 ? (m_header.bounds.yMax - m_header.bounds.yMin) / (float)m_header.height : 1.f;
+}
+
+// PRIVATE
+unsigned int RasterPyramid::makeLevels(std::uint64_t width, std::uint64_t height, Level* levels, std::uint64_t& fileSize)
+{
+	static_assert(sizeof(Header) <= RASTER_PYRAMID_TABLE_OFFSET, "The pyramid header must fit before the level table");
+	static_assert(RASTER_PYRAMID_TABLE_OFFSET + RASTER_MAX_LEVELS * sizeof(Level) <= RASTER_PYRAMID_DATA_OFFSET, "The level table must fit before the tiles");
+
+	unsigned int count(0);
+	fileSize = RASTER_PYRAMID_DATA_OFFSET;
+
+	std::memset(levels, 0, RASTER_MAX_LEVELS * sizeof(Level));
+
+	while (count < RASTER_MAX_LEVELS)
+	{
+		Level& level(levels[count++]);
+
+		level.width = width;
+		level.height = height;
+		level.tilesX = (std::uint32_t)((width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE);
+		level.tilesY = (std::uint32_t)((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE);
+		level.offset = fileSize;
+
+		fileSize += (std::uint64_t)level.tilesX * level.tilesY * RASTER_TILE_SIZE * RASTER_TILE_SIZE * sizeof(float);
+
+		if (width <= RASTER_TILE_SIZE && height <= RASTER_TILE_SIZE)
+			break;
+
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	return count;
+}
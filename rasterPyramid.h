@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "cameraChannel.h"
+#include "mappedFile.h"
+
+// Side of a pyramid tile in texels, a tile is contiguous in the file
+#define RASTER_TILE_SIZE 256
+
+// Levels are halved until one tile holds the whole raster, at most this many
+#define RASTER_MAX_LEVELS 32
+
+// Header, then the level table, then the tiles from the next page on
+#define RASTER_PYRAMID_VERSION 1
+#define RASTER_PYRAMID_TABLE_OFFSET 64
+#define RASTER_PYRAMID_DATA_OFFSET 4096
+
+/*
+- A pyramid file holds a scalar raster and its halved levels, each level stored tile by tile (row major inside a tile)
+- Level n + 1 averages 2x2 texels of level n, non finite texels (and the padding past the raster edge, NaN) are left out
+- The raster covers world bounds chosen at build time, its pixel (0, 0) at (xMin, yMin)
+- The file is memory mapped, a view only reads the pages of the tiles it covers at the level it is shown at
+- build() converts a flat row major float raster (of any size, it is mapped too) in one pass per level
+*/
+
+class RasterPyramid
+{
+	public:
+		struct Level
+		{
+			std::uint64_t width;
+			std::uint64_t height;
+			std::uint32_t tilesX;
+			std::uint32_t tilesY;
+			std::uint64_t offset;		// Of the first tile, in the file
+		};
+
+		RasterPyramid();
+
+		bool open(const std::string& path);
+		void close();
+
+		static bool build(const std::string& sourcePath, std::uint64_t width, std::uint64_t height, const Bounds& bounds, const std::string& path);
+
+		unsigned int getLevelCount() const;
+		const Level& getLevel(unsigned int level) const;
+		const Bounds& getBounds() const;
+		float getValueMin() const;
+		float getValueMax() const;
+
+		// Size of a texel of the full resolution level, in world units
+		float getTexelWidth() const;
+		float getTexelHeight() const;
+
+		const float* tile(unsigned int level, std::uint32_t tileX, std::uint32_t tileY) const
+		{
+			const Level& info(m_levels[level]);
+
+			return m_tiles + (info.offset - RASTER_PYRAMID_DATA_OFFSET) / sizeof(float) + ((std::uint64_t)tileY * info.tilesX + tileX) * RASTER_TILE_SIZE * RASTER_TILE_SIZE;
+		}
+
+	private:
+		struct Header
+		{
+			char magic[8];
+			std::uint32_t version;
+			std::uint32_t levelCount;
+			std::uint64_t width;
+			std::uint64_t height;
+			Bounds bounds;
+			float valueMin;		// Over the finite texels
+			float valueMax;
+		};
+
+		static unsigned int makeLevels(std::uint64_t width, std::uint64_t height, Level* levels, std::uint64_t& fileSize);
+
+		MappedFile m_file;
+		const float* m_tiles;
+
+		Header m_header;
+		Level m_levels[RASTER_MAX_LEVELS];
+};
@@ -0,0 +1,605 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+#include "imageWriter.h"
+#include "renderFarm.h"
+
+static const char FARM_IMAGE_MAGIC[8] = { 'P', 'L', 'O', 'T', 'F', 'A', 'R', 'M' };
+
+// DONE: message, tile, whether pixels follow, then the RGBA rows of the tile
+#define FARM_DONE_HEADER_SIZE 6
+
+struct FarmImageHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t padding;
+	std::uint64_t job;		// Tells a worker the file it opened is this job's, not a namesake on another machine
+};
+
+// Tiles are numbered row by row, the last row and column are cut to the image
+static sf::IntRect farmTileRect(unsigned int tile, unsigned int tilesX, unsigned int width, unsigned int height)
+{
+	int left((int)(tile % tilesX * FARM_TILE_SIZE));
+	int top((int)(tile / tilesX * FARM_TILE_SIZE));
+
+	return sf::IntRect(left, top, std::min(FARM_TILE_SIZE, (int)width - left), std::min(FARM_TILE_SIZE, (int)height - top));
+}
+
+// Sockets are non blocking: a send goes out in parts when the other side reads slowly, the packet keeps where it stopped
+static bool farmSend(sf::TcpSocket& socket, sf::Packet& packet)
+{
+	sf::Clock clock;
+	sf::Socket::Status status;
+
+	while ((status = socket.send(packet)) == sf::Socket::Partial || status == sf::Socket::NotReady)
+	{
+		if (clock.getElapsedTime().asSeconds() > FARM_WORKER_TIMEOUT)
+			return false;
+
+		sf::sleep(sf::milliseconds(1));
+	}
+
+	return status == sf::Socket::Done;
+}
+
+RenderCoordinator::RenderCoordinator()
+{
+	m_job = 0;
+	m_bounds = { 0.f, 1.f, 0.f, 1.f };
+	m_width = 0;
+	m_height = 0;
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_remaining = 0;
+	m_failed = false;
+}
+
+bool RenderCoordinator::run(unsigned short port, const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height, const std::string& identity)
+{
+	if (width == 0 || height == 0)
+		return false;
+
+	m_identity = identity;
+	m_bounds = bounds;
+	m_width = width;
+	m_height = height;
+	m_tilesX = (width + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE;
+	m_tilesY = (height + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE;
+
+	unsigned int tileCount(m_tilesX * m_tilesY);
+
+	std::random_device random;
+	m_job = ((std::uint64_t)random() << 32) | random();
+
+	// Next to the output, absolute so that workers started elsewhere find it
+	std::error_code error;
+	m_imagePath = std::filesystem::absolute(path + ".farm", error).string();
+
+	if (error || !m_image.create(m_imagePath, FARM_PIXEL_OFFSET + (std::uint64_t)width * height * sizeof(sf::Color)))
+	{
+		std::cerr << "Could not create the shared image " << m_imagePath << std::endl;
+		return false;
+	}
+
+	FarmImageHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, FARM_IMAGE_MAGIC, sizeof(FARM_IMAGE_MAGIC));
+	header.version = FARM_PROTOCOL_VERSION;
+	header.width = width;
+	header.height = height;
+	header.job = m_job;
+	std::memcpy(m_image.data(), &header, sizeof(header));
+
+	if (m_listener.listen(port) != sf::Socket::Done)
+	{
+		std::cerr << "Could not listen on port " << port << std::endl;
+
+		m_image.close();
+		std::filesystem::remove(m_imagePath, error);
+		return false;
+	}
+
+	m_selector.add(m_listener);
+
+	m_queue.clear();
+
+	for (unsigned int i(0); i < tileCount; i++)
+		m_queue.push_back(i);
+
+	m_done.assign(tileCount, false);
+	m_attempts.assign(tileCount, 0);
+	m_remaining = tileCount;
+	m_failed = false;
+
+	std::cout << "Waiting for workers on port " << m_listener.getLocalPort() << ", " << tileCount << " tiles to render" << std::endl;
+
+	sf::Clock clock;
+	unsigned int shown(tileCount + 1);
+
+	while (m_remaining > 0 && !m_failed)
+	{
+		if (m_selector.wait(sf::seconds(FARM_POLL_INTERVAL)))
+		{
+			if (m_selector.isReady(m_listener))
+				accept();
+
+			for (std::unique_ptr<Worker>& worker : m_workers)
+			{
+				if (!worker->lost && m_selector.isReady(*worker->socket) && !receive(*worker))
+					worker->lost = true;
+			}
+		}
+
+		for (std::size_t i(m_workers.size()); i-- > 0;)
+		{
+			if (m_workers[i]->rejected)
+				drop(i, "rejected, it renders another kernel or data source");
+			else if (m_workers[i]->lost)
+				drop(i, "lost");
+			else if (!m_workers[i]->tiles.empty() && m_workers[i]->lastHeard.getElapsedTime().asSeconds() > FARM_WORKER_TIMEOUT)
+				drop(i, "timed out");
+		}
+
+		assign();
+
+		if (m_remaining != shown)
+		{
+			shown = m_remaining;
+			std::cout << "\rFarm: " << (tileCount - m_remaining) * 100 / tileCount << "%, " << m_workers.size() << " workers   " << std::flush;
+		}
+	}
+
+	std::cout << std::endl;
+
+	// Workers leave with the job, finished or not
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		sf::Packet packet;
+		packet << (sf::Uint8)FarmMessage::FINISH;
+		send(*worker, packet);
+
+		std::cout << "Worker " << worker->name << ": " << worker->completed << " tiles" << std::endl;
+	}
+
+	m_workers.clear();
+	m_selector.clear();
+	m_listener.close();
+
+	bool success(!m_failed);
+
+	if (success)
+	{
+		ImageWriter writer;
+		success = writer.open(path, width, height);
+
+		// A row of tiles per call: PNG gets one IDAT chunk each, the image is never copied as a whole
+		for (unsigned int top(0); top < height && success; top += FARM_TILE_SIZE)
+		{
+			const sf::Uint8* rows(m_image.data() + FARM_PIXEL_OFFSET + (std::size_t)top * width * sizeof(sf::Color));
+			success = writer.writeRows(rows, std::min((unsigned int)FARM_TILE_SIZE, height - top));
+		}
+
+		success = writer.close() && success;
+
+		if (success)
+			std::cout << "Rendered " << path << " in " << clock.getElapsedTime().asSeconds() << "s" << std::endl;
+	}
+
+	m_image.close();
+	std::filesystem::remove(m_imagePath, error);
+
+	return success;
+}
+
+// PRIVATE
+void RenderCoordinator::accept()
+{
+	std::unique_ptr<Worker> worker(new Worker());
+	worker->socket.reset(new sf::TcpSocket());
+
+	if (m_listener.accept(*worker->socket) != sf::Socket::Done)
+		return;
+
+	// A worker cut off halfway through a message must not hold the coordinator: partial packets wait in the socket
+	worker->socket->setBlocking(false);
+
+	worker->name = worker->socket->getRemoteAddress().toString() + ":" + std::to_string(worker->socket->getRemotePort());
+
+	sf::Packet packet;
+	packet << (sf::Uint8)FarmMessage::JOB << (sf::Uint32)FARM_PROTOCOL_VERSION << (sf::Uint64)m_job << (sf::Uint32)m_width << (sf::Uint32)m_height
+		<< m_bounds.xMin << m_bounds.xMax << m_bounds.yMin << m_bounds.yMax << (sf::Uint32)FARM_TILE_SIZE << m_imagePath;
+
+	if (!send(*worker, packet))
+		return;
+
+	m_selector.add(*worker->socket);
+	m_workers.push_back(std::move(worker));
+}
+
+bool RenderCoordinator::receive(Worker& worker)
+{
+	sf::Packet packet;
+	sf::Socket::Status status;
+
+	// Every whole message waiting, the rest of a partial one comes with a later call (or the worker times out)
+	while ((status = worker.socket->receive(packet)) == sf::Socket::Done)
+	{
+		if (!handle(worker, packet))
+			return false;
+	}
+
+	return status == sf::Socket::NotReady || status == sf::Socket::Partial;
+}
+
+bool RenderCoordinator::handle(Worker& worker, sf::Packet& packet)
+{
+	sf::Uint8 type(0);
+
+	if (!(packet >> type))
+		return false;
+
+	worker.lastHeard.restart();
+
+	if ((FarmMessage)type == FarmMessage::READY)
+	{
+		bool shared(false);
+		std::string identity;
+
+		if (!(packet >> shared >> identity))
+			return false;
+
+		// Its tiles would not match the others', whether it wrote them in place or sent them
+		if (identity != m_identity)
+		{
+			sf::Packet reject;
+			reject << (sf::Uint8)FarmMessage::REJECT << m_identity;
+			send(worker, reject);
+
+			worker.rejected = true;
+			return false;
+		}
+
+		worker.ready = true;
+		worker.shared = shared;
+
+		std::cout << "\nWorker " << worker.name << " joined, " << (shared ? "writing to the shared image" : "sending pixels back") << std::endl;
+		return true;
+	}
+
+	if ((FarmMessage)type != FarmMessage::DONE)
+		return false;
+
+	sf::Uint32 tile(0);
+	bool hasPixels(false);
+
+	if (!(packet >> tile >> hasPixels) || tile >= m_done.size())
+		return false;
+
+	sf::IntRect rect(farmTileRect(tile, m_tilesX, m_width, m_height));
+	std::size_t rowSize((std::size_t)rect.width * sizeof(sf::Color));
+
+	if (hasPixels ? packet.getDataSize() != FARM_DONE_HEADER_SIZE + rowSize * (std::size_t)rect.height : !worker.shared)
+		return false;
+
+	worker.tiles.erase(std::remove(worker.tiles.begin(), worker.tiles.end(), tile), worker.tiles.end());
+
+	// A stolen tile can be finished twice
+	if (m_done[tile])
+		return true;
+
+	if (hasPixels)
+	{
+		const std::uint8_t* source(static_cast<const std::uint8_t*>(packet.getData()) + FARM_DONE_HEADER_SIZE);
+		std::uint8_t* target(m_image.data() + FARM_PIXEL_OFFSET + ((std::size_t)rect.top * m_width + (std::size_t)rect.left) * sizeof(sf::Color));
+
+		for (int y(0); y < rect.height; y++)
+			std::memcpy(target + (std::size_t)y * m_width * sizeof(sf::Color), source + (std::size_t)y * rowSize, rowSize);
+	}
+
+	m_done[tile] = true;
+	m_remaining--;
+	worker.completed++;
+
+	// Whoever else still has it can skip it
+	for (std::unique_ptr<Worker>& other : m_workers)
+	{
+		std::deque<unsigned int>::iterator found(std::find(other->tiles.begin(), other->tiles.end(), tile));
+
+		if (other.get() == &worker || found == other->tiles.end())
+			continue;
+
+		other->tiles.erase(found);
+
+		sf::Packet cancel;
+		cancel << (sf::Uint8)FarmMessage::CANCEL << (sf::Uint32)tile;
+		send(*other, cancel);
+	}
+
+	return true;
+}
+
+void RenderCoordinator::assign()
+{
+	for (std::unique_ptr<Worker>& worker : m_workers)
+	{
+		if (!worker->ready || worker->lost)
+			continue;
+
+		while (worker->tiles.size() < FARM_TILES_IN_FLIGHT)
+		{
+			unsigned int tile;
+
+			if (!m_queue.empty())
+			{
+				tile = m_queue.front();
+				m_queue.pop_front();
+			}
+			else
+			{
+				// Nothing left to hand out: an idle worker takes the last tile waiting behind the current one of the busiest worker
+				if (!worker->tiles.empty())
+					break;
+
+				Worker* victim(nullptr);
+
+				for (std::unique_ptr<Worker>& other : m_workers)
+				{
+					if (!other->lost && other->tiles.size() > 1 && (victim == nullptr || other->tiles.size() > victim->tiles.size()))
+						victim = other.get();
+				}
+
+				if (victim == nullptr)
+					break;
+
+				tile = victim->tiles.back();
+				victim->tiles.pop_back();
+
+				sf::Packet cancel;
+				cancel << (sf::Uint8)FarmMessage::CANCEL << (sf::Uint32)tile;
+				send(*victim, cancel);
+			}
+
+			// An idle worker's silence was not a timeout, its clock starts with its first tile
+			if (worker->tiles.empty())
+				worker->lastHeard.restart();
+
+			worker->tiles.push_back(tile);
+
+			sf::Packet packet;
+			packet << (sf::Uint8)FarmMessage::TILE << (sf::Uint32)tile;
+
+			if (!send(*worker, packet))
+				break;
+		}
+	}
+}
+
+void RenderCoordinator::drop(std::size_t index, const char* reason)
+{
+	Worker& worker(*m_workers[index]);
+
+	// Back to the front of the queue in the same order, only the tile being computed counts as an attempt
+	for (std::deque<unsigned int>::reverse_iterator tile(worker.tiles.rbegin()); tile != worker.tiles.rend(); ++tile)
+	{
+		if (!m_done[*tile])
+			m_queue.push_front(*tile);
+	}
+
+	if (!worker.tiles.empty() && ++m_attempts[worker.tiles.front()] >= FARM_MAX_ATTEMPTS)
+	{
+		std::cerr << "\nTile " << worker.tiles.front() << " was lost by " << FARM_MAX_ATTEMPTS << " workers, giving up" << std::endl;
+		m_failed = true;
+	}
+
+	std::cout << "\nWorker " << worker.name << " " << reason << ", " << worker.tiles.size() << " tiles back in the queue" << std::endl;
+
+	m_selector.remove(*worker.socket);
+	m_workers.erase(m_workers.begin() + (std::ptrdiff_t)index);
+}
+
+bool RenderCoordinator::send(Worker& worker, sf::Packet& packet)
+{
+	if (!farmSend(*worker.socket, packet))
+	{
+		worker.lost = true;
+		return false;
+	}
+
+	return true;
+}
+
+RenderWorker::RenderWorker()
+{
+	m_partial = false;
+}
+
+bool RenderWorker::run(const std::string& host, unsigned short port, const std::string& identity, const AreaFunction& renderArea)
+{
+	sf::Clock clock;
+
+	// The coordinator may not be listening yet
+	while (m_socket.connect(host, port, sf::seconds(FARM_POLL_INTERVAL)) != sf::Socket::Done)
+	{
+		if (clock.getElapsedTime().asSeconds() > FARM_CONNECT_TIMEOUT)
+		{
+			std::cerr << "Could not reach a coordinator at " << host << ":" << port << std::endl;
+			return false;
+		}
+
+		sf::sleep(sf::seconds(FARM_POLL_INTERVAL));
+	}
+
+	// Non blocking from here on, so that a coordinator cut off halfway through a message cannot hold the worker
+	m_socket.setBlocking(false);
+	m_selector.clear();
+	m_selector.add(m_socket);
+	m_partial = false;
+
+	sf::Packet packet;
+	sf::Uint8 type(0);
+	sf::Uint32 version(0), width(0), height(0), tileSize(0);
+	sf::Uint64 job(0);
+	Bounds bounds;
+	std::string imagePath;
+
+	if (receive(packet, true) != sf::Socket::Done
+		|| !(packet >> type >> version >> job >> width >> height >> bounds.xMin >> bounds.xMax >> bounds.yMin >> bounds.yMax >> tileSize >> imagePath)
+		|| (FarmMessage)type != FarmMessage::JOB || version != FARM_PROTOCOL_VERSION || tileSize != FARM_TILE_SIZE || width == 0 || height == 0)
+	{
+		std::cerr << "The coordinator at " << host << ":" << port << " sent no job this worker understands" << std::endl;
+		return false;
+	}
+
+	bool shared(openSharedImage(imagePath, job, width, height));
+
+	packet.clear();
+	packet << (sf::Uint8)FarmMessage::READY << shared << identity;
+
+	if (!farmSend(m_socket, packet))
+		return false;
+
+	std::cout << "Rendering tiles of a " << width << "x" << height << " image for " << host << ":" << port << (shared ? ", in shared memory" : "") << std::endl;
+
+	unsigned int tilesX((width + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE);
+	unsigned int tileCount(tilesX * ((height + FARM_TILE_SIZE - 1) / FARM_TILE_SIZE));
+	unsigned int completed(0);
+
+	std::deque<unsigned int> tiles;
+	std::vector<sf::Color> pixels;
+
+	while (true)
+	{
+		// Messages first, a cancelled tile must not be started; waits for one when there is nothing to compute
+		sf::Socket::Status status;
+
+		while ((status = receive(packet, tiles.empty())) == sf::Socket::Done)
+		{
+			sf::Uint32 tile(0);
+
+			if (!(packet >> type))
+				return false;
+
+			if ((FarmMessage)type == FarmMessage::FINISH)
+			{
+				std::cout << "Job done, " << completed << " tiles computed" << std::endl;
+				return true;
+			}
+
+			if ((FarmMessage)type == FarmMessage::REJECT)
+			{
+				std::string expected;
+				packet >> expected;
+
+				std::cerr << "The coordinator at " << host << ":" << port << " renders " << expected << ", this worker renders " << identity
+					<< " (start it with the same data source and kernel options)" << std::endl;
+				return false;
+			}
+
+			if (!(packet >> tile) || tile >= tileCount)
+				return false;
+
+			if ((FarmMessage)type == FarmMessage::TILE)
+				tiles.push_back(tile);
+			else if ((FarmMessage)type == FarmMessage::CANCEL)
+				tiles.erase(std::remove(tiles.begin(), tiles.end(), tile), tiles.end());
+		}
+
+		if (status != sf::Socket::NotReady)
+		{
+			std::cerr << "Lost the coordinator after " << completed << " tiles" << std::endl;
+			return false;
+		}
+
+		unsigned int tile(tiles.front());
+		tiles.pop_front();
+
+		sf::IntRect rect(farmTileRect(tile, tilesX, width, height));
+
+		packet.clear();
+		packet << (sf::Uint8)FarmMessage::DONE << (sf::Uint32)tile << !shared;
+
+		// Written in place before DONE is sent, the coordinator reads the image once every tile is done
+		if (shared)
+		{
+			sf::Color* image(reinterpret_cast<sf::Color*>(m_image.data() + FARM_PIXEL_OFFSET));
+
+			renderArea(bounds, width, height, rect, image + (std::size_t)rect.top * width + (std::size_t)rect.left, width);
+		}
+		else
+		{
+			pixels.resize((std::size_t)rect.width * (std::size_t)rect.height);
+
+			renderArea(bounds, width, height, rect, pixels.data(), (unsigned int)rect.width);
+			packet.append(pixels.data(), pixels.size() * sizeof(sf::Color));
+		}
+
+		if (!farmSend(m_socket, packet))
+		{
+			std::cerr << "Lost the coordinator after " << completed << " tiles" << std::endl;
+			return false;
+		}
+
+		completed++;
+	}
+}
+
+// PRIVATE
+sf::Socket::Status RenderWorker::receive(sf::Packet& packet, bool wait)
+{
+	while (true)
+	{
+		if (m_selector.wait(wait ? sf::seconds(FARM_POLL_INTERVAL) : sf::microseconds(1)))
+		{
+			sf::Socket::Status status(m_socket.receive(packet));
+
+			if (status == sf::Socket::Done)
+			{
+				m_partial = false;
+				return status;
+			}
+
+			if (status != sf::Socket::NotReady && status != sf::Socket::Partial)
+				return status;
+
+			// Bytes came, not the whole message: the rest must follow before long
+			if (!m_partial)
+			{
+				m_partial = true;
+				m_partialClock.restart();
+			}
+		}
+
+		if (m_partial && m_partialClock.getElapsedTime().asSeconds() > FARM_WORKER_TIMEOUT)
+			return sf::Socket::Disconnected;
+
+		if (!wait)
+			return sf::Socket::NotReady;
+	}
+}
+
+bool RenderWorker::openSharedImage(const std::string& path, std::uint64_t job, unsigned int width, unsigned int height)
+{
+	if (!m_image.open(path, true) || m_image.size() != FARM_PIXEL_OFFSET + (std::uint64_t)width * height * sizeof(sf::Color))
+	{
+		m_image.close();
+		return false;
+	}
+
+	FarmImageHeader header;
+	std::memcpy(&header, m_image.data(), sizeof(header));
+
+	if (std::memcmp(header.magic, FARM_IMAGE_MAGIC, sizeof(FARM_IMAGE_MAGIC)) != 0 || header.version != FARM_PROTOCOL_VERSION
+		|| header.job != job || header.width != width || header.height != height)
+	{
+		m_image.close();
+		return false;
+	}
+
+	return true;
+}
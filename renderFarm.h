@@ -0,0 +1,118 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cameraChannel.h"
+#include "mappedFile.h"
+
+// Side of the tiles a job is split into, a multiple of TILE_SIZE so any worker gets the pixels of a single process render
+#define FARM_TILE_SIZE 256
+
+// Tiles handed to a worker ahead of the one it computes, so it never waits for the next one
+#define FARM_TILES_IN_FLIGHT 2
+
+// A tile whose worker was lost this many times fails the job, a worker silent this long (seconds) while holding tiles is dropped,
+// as is a message (or a send) left unfinished this long
+#define FARM_MAX_ATTEMPTS 3
+#define FARM_WORKER_TIMEOUT 120.f
+
+// The coordinator checks its workers this often, workers retry connecting for this long (seconds)
+#define FARM_POLL_INTERVAL 0.5f
+#define FARM_CONNECT_TIMEOUT 30.f
+
+// Shared image file: header, then RGBA rows from the next page on
+#define FARM_PROTOCOL_VERSION 2
+#define FARM_PIXEL_OFFSET 4096
+
+/*
+- The coordinator splits an image (bounds, size) into FARM_TILE_SIZE tiles and hands them to worker processes over TCP
+- Workers are the same program (same data source and kernel options) started with --worker, on this host or others,
+  READY carries the worker's identity (kernel type, hash of its options and data source), a different one is rejected
+- Each worker holds up to FARM_TILES_IN_FLIGHT tiles, an idle worker steals the tiles still waiting at another one
+- A lost or silent worker's tiles go back to the queue, a tile failing FARM_MAX_ATTEMPTS times fails the job
+- Sockets are non blocking, a peer cut off halfway through a message is caught by FARM_WORKER_TIMEOUT on both sides
+- The image is a memory mapped file next to the output: workers that can open it write their pixels in place,
+  the others (on another machine) send them over their socket, either way the coordinator only writes the file out at the end
+- Messages are sf::Packet, starting with a FarmMessage
+*/
+
+enum class FarmMessage : sf::Uint8 { JOB = 0, READY, TILE, CANCEL, DONE, FINISH, REJECT };
+
+class RenderCoordinator
+{
+	public:
+		RenderCoordinator();
+
+		// Only workers whose identity (see Plot::getFarmIdentity()) is this one get tiles
+		bool run(unsigned short port, const std::string& path, const Bounds& bounds, unsigned int width, unsigned int height, const std::string& identity);
+
+	private:
+		struct Worker
+		{
+			std::unique_ptr<sf::TcpSocket> socket;
+			std::string name;
+			std::deque<unsigned int> tiles;		// Assigned and not done, the first one is being computed
+			bool ready = false;
+			bool shared = false;		// Writes into the shared image
+			bool lost = false;
+			bool rejected = false;		// Renders something else than the coordinator
+			sf::Clock lastHeard;
+			unsigned int completed = 0;
+		};
+
+		void accept();
+		bool receive(Worker& worker);
+		bool handle(Worker& worker, sf::Packet& packet);
+		void assign();
+		void drop(std::size_t index, const char* reason);
+		bool send(Worker& worker, sf::Packet& packet);
+
+		sf::TcpListener m_listener;
+		sf::SocketSelector m_selector;
+		std::vector<std::unique_ptr<Worker>> m_workers;
+
+		MappedFile m_image;
+		std::string m_imagePath;
+		std::string m_identity;
+		std::uint64_t m_job;
+		Bounds m_bounds;
+		unsigned int m_width;
+		unsigned int m_height;
+		unsigned int m_tilesX;
+		unsigned int m_tilesY;
+
+		std::deque<unsigned int> m_queue;
+		std::vector<bool> m_done;
+		std::vector<unsigned int> m_attempts;
+		unsigned int m_remaining;
+		bool m_failed;
+};
+
+class RenderWorker
+{
+	public:
+		// Computes an area of the image (bounds, width, height) into pixels, rows stride pixels apart
+		typedef std::function<void(const Bounds&, unsigned int, unsigned int, const sf::IntRect&, sf::Color*, unsigned int)> AreaFunction;
+
+		RenderWorker();
+
+		// Returns once the coordinator finished the job (true), was lost or rejected the identity (false)
+		bool run(const std::string& host, unsigned short port, const std::string& identity, const AreaFunction& renderArea);
+
+	private:
+		// A whole message (Done), none yet (NotReady, right away unless wait), or the coordinator is lost
+		sf::Socket::Status receive(sf::Packet& packet, bool wait);
+		bool openSharedImage(const std::string& path, std::uint64_t job, unsigned int width, unsigned int height);
+
+		sf::TcpSocket m_socket;
+		sf::SocketSelector m_selector;
+		bool m_partial;		// Part of a message arrived, since m_partialClock
+		sf::Clock m_partialClock;
+		MappedFile m_image;
+};
@@ -1,33 +1,20 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
-#include <mutex>
+
+#include "frameBuffer.h"
+#include "cameraChannel.h"
+#include "perfStats.h"
+#include "traceRecorder.h"
 
 #define FPS_TARGET 60.f
 #define DEBUG_FONT_SIZE 16
-
-#define DEFAULT_WIN_WIDTH 1280
-#define DEFAULT_WIN_HEIGHT 720
-
-enum class Event { NONE = 0, CAMERA_MOVED, WINDOW_RESIZED };
-
-struct Bounds
-{
-	float xMin;
-	float xMax;
-
-	float yMin;
-	float yMax;
-};
+#define BACKGROUND_COLOR sf::Color(10, 10, 10)
 
 struct SharedData
 {
-	sf::Uint8* pixels = nullptr;
-	unsigned int windowWidth = DEFAULT_WIN_WIDTH;
-	unsigned int windowHeight = DEFAULT_WIN_HEIGHT;
-
-	Event eventType = Event::NONE;
-	Bounds plotBounds = { 0.f, 0.f, 0.f, 0.f };
-
-	std::mutex mutex;
+	FrameBuffer frameBuffer;	// Compute -> window: pixels
+	CameraChannel camera;		// Window -> compute: what to render
+	PerfStats stats;			// Both: timings shown by the debug panel
+	TraceRecorder trace;		// Both: timeline dumped on demand
 };
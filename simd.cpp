@@ -0,0 +1,138 @@
+#include "simd.h"
+
+#if defined(_MSC_VER) && defined(SIMD_X86)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(SIMD_X86)
+static bool osSupportsAvx(unsigned long long mask)
+{
+	int info[4];
+	__cpuid(info, 1);
+
+	// OSXSAVE, then check the OS saves the requested register state
+	if (!(info[2] & (1 << 27)))
+		return false;
+
+	return (_xgetbv(0) & mask) == mask;
+}
+#endif
+
+SimdLevel Simd::detectLevel()
+{
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return SimdLevel::AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SimdLevel::AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SimdLevel::SSE2;
+#elif defined(SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuidex(info, 7, 0);
+	bool avx2((info[1] & (1 << 5)) != 0);
+	bool avx512((info[1] & (1 << 16)) != 0);
+
+	if (avx512 && osSupportsAvx(0xE6))
+		return SimdLevel::AVX512;
+	if (avx2 && osSupportsAvx(0x6))
+		return SimdLevel::AVX2;
+
+	__cpuid(info, 1);
+	if (info[3] & (1 << 26))
+		return SimdLevel::SSE2;
+#endif
+
+	return SimdLevel::SCALAR;
+}
+
+unsigned int Simd::width(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX512: return 16;
+		case SimdLevel::AVX2: return 8;
+		case SimdLevel::SSE2: return 4;
+		default: return 1;
+	}
+}
+
+const char* Simd::name(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX512: return "AVX-512";
+		case SimdLevel::AVX2: return "AVX2";
+		case SimdLevel::SSE2: return "SSE2";
+		default: return "Scalar";
+	}
+}
+
+static void fillCoordinatesScalar(float* x, float x0, float dx, unsigned int count)
+{
+	for (unsigned int i(0); i < count; i++)
+		x[i] = x0 + (float)i * dx;
+}
+
+#ifdef SIMD_X86
+SIMD_TARGET("sse2") static void fillCoordinatesSse2(float* x, float x0, float dx, unsigned int count)
+{
+	__m128 index = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+	__m128 step = _mm_set1_ps(4.f);
+	__m128 origin = _mm_set1_ps(x0);
+	__m128 delta = _mm_set1_ps(dx);
+
+	for (unsigned int i(0); i < count; i += 4)
+	{
+		_mm_store_ps(x + i, _mm_add_ps(origin, _mm_mul_ps(index, delta)));
+		index = _mm_add_ps(index, step);
+	}
+}
+
+SIMD_TARGET("avx2") static void fillCoordinatesAvx2(float* x, float x0, float dx, unsigned int count)
+{
+	__m256 index = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+	__m256 step = _mm256_set1_ps(8.f);
+	__m256 origin = _mm256_set1_ps(x0);
+	__m256 delta = _mm256_set1_ps(dx);
+
+	for (unsigned int i(0); i < count; i += 8)
+	{
+		_mm256_store_ps(x + i, _mm256_add_ps(origin, _mm256_mul_ps(index, delta)));
+		index = _mm256_add_ps(index, step);
+	}
+}
+
+SIMD_TARGET("avx512f") static void fillCoordinatesAvx512(float* x, float x0, float dx, unsigned int count)
+{
+	__m512 index = _mm512_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f, 13.f, 14.f, 15.f);
+	__m512 step = _mm512_set1_ps(16.f);
+	__m512 origin = _mm512_set1_ps(x0);
+	__m512 delta = _mm512_set1_ps(dx);
+
+	for (unsigned int i(0); i < count; i += 16)
+	{
+		_mm512_store_ps(x + i, _mm512_add_ps(origin, _mm512_mul_ps(index, delta)));
+		index = _mm512_add_ps(index, step);
+	}
+}
+#endif
+
+void Simd::fillCoordinates(SimdLevel level, float* x, float x0, float dx, unsigned int count)
+{
+	// The buffer is padded, so the vector paths may round count up to their width
+#ifdef SIMD_X86
+	switch (level)
+	{
+		case SimdLevel::AVX512: fillCoordinatesAvx512(x, x0, dx, count); return;
+		case SimdLevel::AVX2: fillCoordinatesAvx2(x, x0, dx, count); return;
+		case SimdLevel::SSE2: fillCoordinatesSse2(x, x0, dx, count); return;
+		default: break;
+	}
+#endif
+
+	fillCoordinatesScalar(x, x0, dx, count);
+}
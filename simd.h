@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstring>
+
+/*
+- Row kernels receive a whole row of world coordinates (see kernels.h)
+- The best instruction set is picked once at runtime (CPUID), the scalar path always exists
+- Wider paths are compiled per function with SIMD_TARGET, the rest of the program keeps the default flags
+*/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+#define SIMD_MAX_WIDTH 16
+#define SIMD_ALIGNMENT 64
+
+enum class SimdLevel { SCALAR = 0, SSE2, AVX2, AVX512 };
+
+// Screen to world transform, computed once per frame: world = origin + pixel * step
+struct Affine
+{
+	float x0;
+	float dx;
+	float y0;
+	float dy;
+};
+
+struct PixelRow
+{
+	const float* x;		// SIMD_ALIGNMENT aligned, padded to a multiple of SIMD_MAX_WIDTH
+	float y;
+	unsigned int count;
+};
+
+namespace Simd
+{
+	SimdLevel detectLevel();
+	unsigned int width(SimdLevel level);
+	const char* name(SimdLevel level);
+
+	void fillCoordinates(SimdLevel level, float* x, float x0, float dx, unsigned int count);
+
+	inline sf::Uint32 pack(sf::Color color)
+	{
+		// Byte order in memory is R, G, B, A whatever the endianness
+		sf::Uint32 packed;
+		sf::Uint8 bytes[4] = { color.r, color.g, color.b, color.a };
+
+		std::memcpy(&packed, bytes, 4);
+
+		return packed;
+	}
+}
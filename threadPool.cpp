@@ -0,0 +1,152 @@
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+
+    if (threadCount == 0)
+        threadCount = 1;
+
+    m_task = nullptr;
+    m_remaining = 0;
+    m_jobId = 0;
+    m_stop = false;
+
+    // The last queue belongs to the thread calling parallelFor()
+    for (unsigned int i(0); i < threadCount; i++)
+        m_queues.push_back(new TaskQueue());
+
+    for (unsigned int i(0); i + 1 < threadCount; i++)
+        m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    m_mutex.lock();
+    m_stop = true;
+    m_mutex.unlock();
+
+    m_wakeCondition.notify_all();
+
+    for (unsigned int i(0); i < m_workers.size(); i++)
+        m_workers[i].join();
+
+    for (unsigned int i(0); i < m_queues.size(); i++)
+        delete m_queues[i];
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)>& task)
+{
+    if (count == 0)
+        return;
+
+    std::lock_guard<std::mutex> submitLock(m_submitMutex);
+
+    unsigned int queueCount((unsigned int)m_queues.size());
+
+    m_task = &task;
+    m_remaining = count;
+
+    // Contiguous chunks keep neighbouring tiles on the same core
+    for (unsigned int q(0); q < queueCount; q++)
+    {
+        unsigned int begin((unsigned int)((unsigned long long)count * q / queueCount));
+        unsigned int end((unsigned int)((unsigned long long)count * (q + 1) / queueCount));
+
+        std::lock_guard<std::mutex> queueLock(m_queues[q]->mutex);
+        for (unsigned int i(begin); i < end; i++)
+            m_queues[q]->indices.push_back(i);
+    }
+
+    m_mutex.lock();
+    m_jobId++;
+    m_mutex.unlock();
+    m_wakeCondition.notify_all();
+
+    runTasks(queueCount - 1);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this] { return m_remaining.load() == 0; });
+
+    m_task = nullptr;
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+    return (unsigned int)m_queues.size();
+}
+
+// PRIVATE
+void ThreadPool::workerLoop(unsigned int id)
+{
+    unsigned int lastJobId(0);
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeCondition.wait(lock, [this, lastJobId] { return m_stop || m_jobId != lastJobId; });
+
+            if (m_stop)
+                return;
+
+            lastJobId = m_jobId;
+        }
+
+        runTasks(id);
+    }
+}
+
+void ThreadPool::runTasks(unsigned int id)
+{
+    unsigned int index;
+
+    while (popTask(id, index) || stealTask(id, index))
+    {
+        (*m_task)(index);
+
+        if (m_remaining.fetch_sub(1) == 1)
+        {
+            // Lock so the notification cannot slip between the waiter's check and its sleep
+            m_mutex.lock();
+            m_mutex.unlock();
+            m_doneCondition.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popTask(unsigned int id, unsigned int& index)
+{
+    std::lock_guard<std::mutex> lock(m_queues[id]->mutex);
+
+    if (m_queues[id]->indices.empty())
+        return false;
+
+    index = m_queues[id]->indices.front();
+    m_queues[id]->indices.pop_front();
+
+    return true;
+}
+
+bool ThreadPool::stealTask(unsigned int id, unsigned int& index)
+{
+    unsigned int queueCount((unsigned int)m_queues.size());
+
+    for (unsigned int i(1); i < queueCount; i++)
+    {
+        TaskQueue* victim(m_queues[(id + i) % queueCount]);
+        std::lock_guard<std::mutex> lock(victim->mutex);
+
+        // Steal from the far end to stay away from the owner's working set
+        if (!victim->indices.empty())
+        {
+            index = victim->indices.back();
+            victim->indices.pop_back();
+
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+- Persistent workers, one task queue per worker
+- parallelFor() deals the indices out in contiguous chunks, idle workers steal from the others
+- The calling thread takes part in the work and returns once every index has been processed
+*/
+
+class ThreadPool
+{
+	public:
+		ThreadPool(unsigned int threadCount = 0);
+		~ThreadPool();
+
+		void parallelFor(unsigned int count, const std::function<void(unsigned int)>& task);
+		unsigned int getThreadCount() const;
+
+	private:
+		struct TaskQueue
+		{
+			std::deque<unsigned int> indices;
+			std::mutex mutex;
+		};
+
+		void workerLoop(unsigned int id);
+		void runTasks(unsigned int id);
+		bool popTask(unsigned int id, unsigned int& index);
+		bool stealTask(unsigned int id, unsigned int& index);
+
+		std::vector<std::thread> m_workers;
+		std::vector<TaskQueue*> m_queues;
+
+		const std::function<void(unsigned int)>* m_task;
+		std::atomic<unsigned int> m_remaining;
+
+		std::mutex m_submitMutex;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeCondition;
+		std::condition_variable m_doneCondition;
+		unsigned int m_jobId;
+		bool m_stop;
+};
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <iterator>
+
+#include "tileCache.h"
+
+bool TileKey::operator==(const TileKey& other) const
+{
+    return levelX == other.levelX && levelY == other.levelY && tileX == other.tileX && tileY == other.tileY;
+}
+
+std::size_t TileKeyHash::operator()(const TileKey& key) const
+{
+    std::size_t hash(std::hash<long long>()(key.tileX));
+
+    hash = hash * 31 + std::hash<long long>()(key.tileY);
+    hash = hash * 31 + std::hash<int>()(key.levelX);
+    hash = hash * 31 + std::hash<int>()(key.levelY);
+
+    return hash;
+}
+
+TileCache::TileCache(unsigned int tileSize, std::size_t budget)
+{
+    m_tileSize = tileSize;
+    m_budget = budget;
+    m_size = 0;
+}
+
+const sf::Color* TileCache::find(const TileKey& key)
+{
+    auto it = m_index.find(key);
+
+    if (it == m_index.end())
+        return nullptr;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    return it->second->pixels.data();
+}
+
+bool TileCache::contains(const TileKey& key) const
+{
+    return m_index.count(key) != 0;
+}
+
+void TileCache::store(const TileKey& key, const sf::Color* pixels, unsigned int stride)
+{
+    std::size_t tileBytes(m_tileSize * m_tileSize * sizeof(sf::Color));
+
+    if (tileBytes > m_budget || contains(key))
+        return;
+
+    // Reuse the least recently used tile (its node and storage) when the cache is full, it is overwritten in place
+    if (m_size + tileBytes > m_budget && !m_entries.empty())
+    {
+        m_index.erase(m_entries.back().key);
+        m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+        m_size -= tileBytes;
+    }
+    else
+    {
+        m_entries.emplace_front();
+    }
+
+    Entry& entry(m_entries.front());
+    entry.key = key;
+    entry.pixels.resize(m_tileSize * m_tileSize);
+
+    for (unsigned int y(0); y < m_tileSize; y++)
+        std::copy(pixels + y * stride, pixels + y * stride + m_tileSize, entry.pixels.begin() + y * m_tileSize);
+
+    m_index[key] = m_entries.begin();
+    m_size += tileBytes;
+
+    evict();
+}
+
+void TileCache::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+    m_size = 0;
+}
+
+void TileCache::setBudget(std::size_t budget)
+{
+    m_budget = budget;
+
+    evict();
+}
+
+std::size_t TileCache::getSize() const
+{
+    return m_size;
+}
+
+// PRIVATE
+void TileCache::evict()
+{
+    while (m_size > m_budget && !m_entries.empty())
+    {
+        m_index.erase(m_entries.back().key);
+        m_entries.pop_back();
+        m_size -= m_tileSize * m_tileSize * sizeof(sf::Color);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Default memory budget of the tile cache, in bytes
+#define TILE_CACHE_BUDGET (128 * 1024 * 1024)
+
+/*
+- Finished pixels, stored by world tile: quantized pixel size (scale level) and tile index on the world pixel grid
+- Least recently used tiles are evicted first once the memory budget is exceeded
+- Only used from the compute thread, no locking
+*/
+
+struct TileKey
+{
+	int levelX;
+	int levelY;
+	long long tileX;
+	long long tileY;
+
+	bool operator==(const TileKey& other) const;
+};
+
+struct TileKeyHash
+{
+	std::size_t operator()(const TileKey& key) const;
+};
+
+class TileCache
+{
+	public:
+		TileCache(unsigned int tileSize, std::size_t budget = TILE_CACHE_BUDGET);
+
+		const sf::Color* find(const TileKey& key);
+		bool contains(const TileKey& key) const;
+		void store(const TileKey& key, const sf::Color* pixels, unsigned int stride);
+		void clear();
+
+		void setBudget(std::size_t budget);
+		std::size_t getSize() const;
+
+	private:
+		struct Entry
+		{
+			TileKey key;
+			std::vector<sf::Color> pixels;
+		};
+
+		void evict();
+
+		std::list<Entry> m_entries;		// Most recently used first
+		std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> m_index;
+
+		unsigned int m_tileSize;
+		std::size_t m_budget;
+		std::size_t m_size;
+};
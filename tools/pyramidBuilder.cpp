@@ -0,0 +1,45 @@
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+#include "../rasterPyramid.h"
+
+/*
+- Converts a flat row major raster of 32 bit floats into a pyramid file, to open with --raster
+- The raster covers the given world bounds, its pixel size by default (0 to width, 0 to height)
+- Usage: pyramidBuilder <raster.f32> <width> <height> <out.pyramid> [<xMin> <xMax> <yMin> <yMax>]
+*/
+
+int main(int argc, char* argv[])
+{
+    if (argc != 5 && argc != 9)
+    {
+        std::cerr << "Usage: " << argv[0] << " <raster.f32> <width> <height> <out.pyramid> [<xMin> <xMax> <yMin> <yMax>]" << std::endl;
+        return 1;
+    }
+
+    unsigned long long width(strtoull(argv[2], nullptr, 10));
+    unsigned long long height(strtoull(argv[3], nullptr, 10));
+    Bounds bounds = { 0.f, (float)width, 0.f, (float)height };
+
+    if (argc == 9)
+        bounds = { strtof(argv[5], nullptr), strtof(argv[6], nullptr), strtof(argv[7], nullptr), strtof(argv[8], nullptr) };
+
+    if (!RasterPyramid::build(argv[1], width, height, bounds, argv[4]))
+    {
+        std::cerr << "Could not convert " << argv[1] << " (" << width << "x" << height << " floats) to " << argv[4] << std::endl;
+        return 1;
+    }
+
+    RasterPyramid pyramid;
+
+    if (!pyramid.open(argv[4]))
+    {
+        std::cerr << "Could not read back " << argv[4] << std::endl;
+        return 1;
+    }
+
+    std::cout << argv[4] << ": " << pyramid.getLevelCount() << " levels, values from " << pyramid.getValueMin() << " to " << pyramid.getValueMax() << std::endl;
+
+    return 0;
+}
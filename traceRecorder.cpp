@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "traceRecorder.h"
+
+std::atomic<unsigned long long> TraceRecorder::s_instanceCount(0);
+
+TraceRecorder::TraceRecorder()
+{
+	m_enabled = false;
+	m_start = Clock::now();
+	m_instance = ++s_instanceCount;
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	for (unsigned int i(0); i < m_rings.size(); i++)
+		delete m_rings[i];
+}
+
+void TraceRecorder::setOutput(const std::string& path)
+{
+	m_path = path;
+	m_enabled.store(!path.empty(), std::memory_order_relaxed);
+}
+
+const std::string& TraceRecorder::getOutput() const
+{
+	return m_path;
+}
+
+void TraceRecorder::nameThread(const char* name)
+{
+	if (!isEnabled())
+		return;
+
+	Ring* ring(threadRing());
+
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+	ring->threadName = name;
+}
+
+void TraceRecorder::record(const char* name, Clock::time_point begin, Clock::time_point end)
+{
+	Ring* ring(threadRing());
+	unsigned long long head(ring->head.load(std::memory_order_relaxed));
+	Event& event(ring->events[head % TRACE_RING_SIZE]);
+
+	event.name.store(name, std::memory_order_relaxed);
+	event.begin.store(std::chrono::duration_cast<std::chrono::nanoseconds>(begin - m_start).count(), std::memory_order_relaxed);
+	event.end.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count(), std::memory_order_relaxed);
+
+	// Publishes the span to dump()
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool TraceRecorder::dump()
+{
+	if (!isEnabled())
+		return false;
+
+	std::lock_guard<std::mutex> dumpLock(m_dumpMutex);
+	std::ofstream file(m_path);
+
+	if (!file)
+		return false;
+
+	struct Span
+	{
+		const char* name;
+		long long begin;
+		long long end;
+	};
+
+	std::vector<Ring*> rings;
+	std::vector<const char*> threadNames;
+	std::vector<Span> spans;
+
+	{
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+		rings = m_rings;
+		for (unsigned int i(0); i < rings.size(); i++)
+			threadNames.push_back(rings[i]->threadName);
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::fixed << std::setprecision(3);
+
+	for (unsigned int i(0); i < rings.size(); i++)
+	{
+		Ring& ring(*rings[i]);
+
+		if (i > 0)
+			file << ",";
+
+		file << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring.id << ",\"args\":{\"name\":\"";
+
+		if (threadNames[i] != nullptr)
+			file << threadNames[i];
+		else
+			file << "thread " << ring.id;
+
+		file << "\"}}";
+
+		unsigned long long last(ring.head.load(std::memory_order_acquire));
+		unsigned long long first(last > TRACE_RING_SIZE ? last - TRACE_RING_SIZE : 0);
+
+		spans.clear();
+		for (unsigned long long index(first); index < last; index++)
+		{
+			const Event& event(ring.events[index % TRACE_RING_SIZE]);
+			spans.push_back({ event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed) });
+		}
+
+		// The owner kept recording during the copy: the slots it reached (and the one it may be writing) are not trustworthy
+		std::atomic_thread_fence(std::memory_order_acquire);
+		unsigned long long written(ring.head.load(std::memory_order_relaxed));
+		unsigned long long firstValid(written + 1 > TRACE_RING_SIZE ? written + 1 - TRACE_RING_SIZE : 0);
+
+		for (unsigned long long index(std::max(first, firstValid)); index < last; index++)
+		{
+			const Span& span(spans[index - first]);
+
+			// Complete events, timestamps in microseconds
+			file << ",\n{\"name\":\"" << span.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring.id
+				<< ",\"ts\":" << span.begin * 1e-3 << ",\"dur\":" << (span.end - span.begin) * 1e-3 << "}";
+		}
+	}
+
+	file << "\n]}\n";
+
+	return (bool)file;
+}
+
+// PRIVATE
+TraceRecorder::Ring* TraceRecorder::threadRing()
+{
+	// One cached ring per thread, recording into another recorder from the same thread registers a new one
+	static thread_local unsigned long long instance(0);
+	static thread_local Ring* ring(nullptr);
+
+	if (instance == m_instance)
+		return ring;
+
+	std::lock_guard<std::mutex> lock(m_ringsMutex);
+
+	ring = new Ring();
+	ring->id = (unsigned int)m_rings.size() + 1;
+	ring->threadName = nullptr;
+	ring->head = 0;
+
+	m_rings.push_back(ring);
+	instance = m_instance;
+
+	return ring;
+}
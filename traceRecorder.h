@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Spans kept per thread, the oldest ones are overwritten
+#define TRACE_RING_SIZE 65536
+
+/*
+- Spans are recorded per thread into a ring owned by that thread, the only lock is taken the first time a thread records
+- A ring has a single writer: it stores the span, then advances its counter, dump() copies behind it without stopping anyone
+- Spans overwritten while they were being copied are left out of the dump
+- dump() writes Chrome Trace Event JSON, to open in chrome://tracing or ui.perfetto.dev
+- Nothing is recorded until setOutput() is called, then a span costs two clock reads and a few relaxed stores
+- Span and thread names must be string literals, only their address is stored
+*/
+
+class TraceRecorder
+{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		TraceRecorder();
+		~TraceRecorder();
+
+		void setOutput(const std::string& path);
+		bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+		const std::string& getOutput() const;
+
+		// Calling thread
+		void nameThread(const char* name);
+		void record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+		bool dump();
+
+	private:
+		struct Event
+		{
+			std::atomic<const char*> name;
+			std::atomic<long long> begin;		// Nanoseconds since the recorder was created
+			std::atomic<long long> end;
+		};
+
+		struct Ring
+		{
+			unsigned int id;
+			const char* threadName;				// Behind m_ringsMutex
+			std::atomic<unsigned long long> head;	// Spans ever recorded, the next one goes to head % TRACE_RING_SIZE
+			Event events[TRACE_RING_SIZE];
+		};
+
+		Ring* threadRing();
+
+		std::atomic<bool> m_enabled;
+		std::string m_path;
+		Clock::time_point m_start;
+		unsigned long long m_instance;		// Tells a thread's cached ring from one of a previous recorder
+
+		std::vector<Ring*> m_rings;
+		std::mutex m_ringsMutex;
+		std::mutex m_dumpMutex;
+
+		static std::atomic<unsigned long long> s_instanceCount;
+};
+
+// Records its scope as a span, only reads the clock when the recorder is enabled
+class TraceSpan
+{
+	public:
+		TraceSpan(TraceRecorder& recorder, const char* name) : m_recorder(recorder), m_name(name), m_enabled(recorder.isEnabled())
+		{
+			if (m_enabled)
+				m_begin = TraceRecorder::Clock::now();
+		}
+
+		~TraceSpan()
+		{
+			if (m_enabled)
+				m_recorder.record(m_name, m_begin, TraceRecorder::Clock::now());
+		}
+
+	private:
+		TraceRecorder& m_recorder;
+		const char* m_name;
+		bool m_enabled;
+		TraceRecorder::Clock::time_point m_begin;
+};